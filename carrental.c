@@ -10,276 +10,858 @@
 // ㆍThe bus always spends at least 5 minutes at each location. If no loading or unloading is in process after 5 minutes, the bus will leave immediately.
 // Run a simulation for 80 hours and gather statistics
 
+#include <ctype.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
 #include "simlib.h" /* Required for use of simlib.c. */
 
-#define RENTAL_ID 3                       /* Location number for the car rental. */
-#define TERMINAL_1_ID 1                   /* Location number for terminal 1. */
-#define TERMINAL_2_ID 2                   /* Location number for terminal 2. */
-#define BUS_ID 4                          /* Location number for the bus. */
-#define EVENT_PERSON_ARRIVAL_RENTAL 1     /* Event type for arrival of a person to the car rental. */
-#define EVENT_PERSON_ARRIVAL_TERMINAL_1 2 /* Event type for arrival of a person to terminal 1. */
-#define EVENT_PERSON_ARRIVAL_TERMINAL_2 3 /* Event type for arrival of a person to terminal 2. */
-#define EVENT_BUS_ARRIVAL 4               /* Event type for arrival of a bus in a location. */
-#define EVENT_BUS_DEPARTURE 5             /* Event type for departure of a bus from a location. */
-#define EVENT_UNLOAD_PERSON 6             /* Event type for loading a person to the bus. */
-#define EVENT_LOAD_PERSON 7               /* Event type for unloading a person from the bus. */
-#define EVENT_END_SIMULATION 8            /* Event type for end of the simulation. */
-#define STREAM_INTERARRIVAL_RENTAL 1      /* Random-number stream for interarrivals. */
-#define STREAM_INTERARRIVAL_TERMINAL_1 2  /* Random-number stream for interarrivals. */
-#define STREAM_INTERARRIVAL_TERMINAL_2 3  /* Random-number stream for interarrivals. */
+#define MAX_STOPS 100                     /* Max number of stops (more than 97 need the mrg32k3a generator, see num_streams()). */
+#define STOP_NAME 32                      /* Max length of the name of a stop. */
+#define RENTAL_ID 1                       /* Stop number of the car rental in the built-in network. */
+#define TERMINAL_1_ID 2                   /* Stop number of terminal 1 in the built-in network. */
+#define TERMINAL_2_ID 3                   /* Stop number of terminal 2 in the built-in network. */
+#define BUS_LIST(m) ((m)->num_stops + 1)  /* List of the buses (it only tracks the number of people on the buses). */
+#define SVAR_DELAY(m, stop) (stop)        /* sampst variable for the delay at a stop. */
+#define SVAR_STOP_TIME(m, stop) ((m)->num_stops + 2 + (stop)) /* sampst variable for the bus stop time at a stop. */
+#define SVAR_LAP(m) (2 * (m)->num_stops + 4) /* sampst variable for the bus lap time. */
+#define SVAR_TIME_IN_SYSTEM(m, stop) (2 * (m)->num_stops + 4 + (stop)) /* sampst variable for the time in system of the people from a stop. */
+#define MAX_BUSES 256                     /* Max number of buses. */
+#define MAX_SEATS 64                      /* Max capacity of a bus. */
+#define MAX_STEPS (2 * MAX_SEATS + 1)     /* Max number of steps a bus plans at a stop: one to unload each rider and one more, one to load each seat. */
+#define EVENT_BUS 3                       /* Attribute of bus events holding the number of the bus. */
+#define EVENT_STOP 3                      /* Attribute of person arrival events holding the stop. */
+#define EVENT_LOCATION 4                  /* Attribute of events holding the stop they happen at (for the trace only). */
+#define NO_BUS -1                         /* End of a list of buses. */
+#define NO_SEAT -1                        /* End of a list of seats. */
+#define EVENT_PERSON_ARRIVAL 1            /* Event type for arrival of a person to a stop. */
+#define EVENT_BUS_ARRIVAL 2               /* Event type for arrival of a bus in a location. */
+#define EVENT_BUS_DEPARTURE 3             /* Event type for departure of a bus from a location. */
+#define EVENT_UNLOAD_PERSON 4             /* Event type for loading a person to the bus. */
+#define EVENT_LOAD_PERSON 5               /* Event type for unloading a person from the bus. */
+#define EVENT_END_SIMULATION 6            /* Event type for end of the simulation. */
+#define STREAM_INTERARRIVAL(stop) ((stop) <= 3 ? (stop) : (stop) + 3) /* Random-number stream for interarrivals at a stop (4 to 6 are taken). */
 #define STREAM_UNLOADING 4                /* Random-number stream for job types. */
 #define STREAM_LOADING 5                  /* Random-number stream for service times. */
-#define STREAM_DESTINATION 6              /* Random-number stream for determining the destination of a person from car rental. */
-
-/* Declare non-simlib global variables. */
-int bus_capacity = 20, current_bus_location = RENTAL_ID;
-int unload_time_lower = 16, unload_time_upper = 24, load_time_lower = 15, load_time_upper = 25;                                              // in seconds
-double bus_speed = 30.0 / 60.0 / 60.0;                                                                                                       // in miles per second
-double terminal_1_arrival_rate = 14.0 / 60.0 / 60.0, terminal_2_arrival_rate = 10.0 / 60.0 / 60.0, rental_arrival_rate = 24.0 / 60.0 / 60.0; // in per second
-double distance_rental_terminal_1 = 4.5, distance_terminal_1_terminal_2 = 1.0, distance_terminal_2_rental = 4.5;                             // in miles
-double destination_terminal_1_probability = 0.583, destination_terminal_2_probability = 0.417;
-double length_simulation = 80.0 * 60.0 * 60.0; // we observe clock in seconds
-double last_bus_arrive_time = 0.0;             // Timer to keep track of bus stop time at a location.
-double last_bus_at_rental = 0.0;               // Timer to keep track of bus stop time at rental.
-double bus_wait_time = 5.0 * 60.0;
-double current_bus_wait_time = 0.0;
-int bus_arrived = 0;
-int is_unloading = 0;
+#define STREAM_DESTINATION 6              /* Random-number stream for determining the destination of a person. */
+#define MAX_STATS (10 * MAX_STOPS + 5)    /* Max number of statistics printed by report() and gathered by collect(). */
+#define SCENARIO_LABEL 512                /* Max length of the settings that make a sweep scenario. */
+#define CSV_LINE 131072                   /* Max length of a row of the sweep CSV file. */
+
+/* Parameters and state of one run of the model. Everything a run changes lives here (the rest is in the simlib context), so runs can proceed side
+   by side in different threads. The state of the buses is kept as one array per field, indexed by the number of the bus (0 to num_buses - 1),
+   and the people on a bus in arrays of seats, chained into one FIFO compartment per destination, so that every event touches a few words of
+   one bus whatever the size of the fleet or of the bus. The buses at each location are chained through bus_next_docked, so an arrival only looks at the buses where it happens.
+   The route network is kept as arrays indexed by stop (1 to num_stops): the buses drive from each stop to next_stop, and the people arriving
+   at a stop go to destination[stop][k] with probability destination_probability[stop][k], drawn from an alias table. */
+struct model {
+    // Parameters.
+    int num_buses;
+    int bus_capacity;
+    int unload_time_lower, unload_time_upper, load_time_lower, load_time_upper; // in seconds
+    double bus_speed;                                                          // in miles per second
+    double length_simulation; // we observe clock in seconds
+    double bus_wait_time;
+    double arrival_scale;                        // Factor applied to the arrival rates of all the stops.
+    int aggregate_dwell;                         // Whether a bus plans its whole stop on arrival (see bus_plan()) instead of an event per person, for the same model.
+    int lazy_arrivals;                           // Whether people arrive through events only at stops with a bus (see arrivals_until()).
+    // Route network.
+    int num_stops;
+    int depot;                                   // Stop the buses start from, where their laps are timed.
+    char stop_name[MAX_STOPS + 1][STOP_NAME];
+    double arrival_rate[MAX_STOPS + 1];          // in per second
+    int next_stop[MAX_STOPS + 1];
+    double distance[MAX_STOPS + 1];              // to the next stop, in miles
+    int num_destinations[MAX_STOPS + 1];
+    int destination[MAX_STOPS + 1][MAX_STOPS + 1];            // 1 to num_destinations, as random_alias draws them
+    double destination_probability[MAX_STOPS + 1][MAX_STOPS + 1];
+    struct alias_table destination_table[MAX_STOPS + 1]; // Built by start() from destination_probability.
+    // State.
+    int bus_location[MAX_BUSES];           // Where each bus is, or is heading for.
+    char bus_arrived[MAX_BUSES];           // Whether each bus is at its location.
+    char bus_unloading[MAX_BUSES];         // Whether each bus is unloading.
+    char bus_loading[MAX_BUSES];           // Whether each bus is loading a person.
+    double bus_arrive_time[MAX_BUSES];     // Timer to keep track of bus stop time at a location.
+    double bus_at_depot[MAX_BUSES];        // Timer to keep track of bus lap time at the depot.
+    long long bus_departure[MAX_BUSES];    // Handle of the pending departure of each bus, if any.
+    int bus_next_docked[MAX_BUSES];        // Next bus at the same location, or NO_BUS.
+    int docked[MAX_STOPS + 1];             // First bus at each location, or NO_BUS.
+    int riders[MAX_BUSES];                 // Number of people on each bus.
+    int total_riders;                      // Number of people on all the buses.
+    double rider_arrival[MAX_BUSES][MAX_SEATS]; // Arrival time of the person in each seat of each bus.
+    char rider_origin[MAX_BUSES][MAX_SEATS];    // Origin of the person in each seat of each bus.
+    signed char seat_next[MAX_BUSES][MAX_SEATS]; // Next seat in the same compartment, or among the free seats, or NO_SEAT.
+    signed char compartment_head[MAX_BUSES][MAX_STOPS + 1]; // First seat of the people on each bus bound for each stop, or NO_SEAT.
+    signed char compartment_tail[MAX_BUSES][MAX_STOPS + 1]; // Last seat of those people, if there is a first.
+    signed char free_seat[MAX_BUSES];      // First free seat of each bus, or NO_SEAT.
+    // Plans of the stops of the buses, with aggregate_dwell.
+    double step_end[MAX_BUSES][MAX_STEPS]; // End time of each planned step of each bus: its unloading steps, then its loading steps.
+    int num_unloading[MAX_BUSES];          // Number of unloading steps planned for each bus.
+    int num_steps[MAX_BUSES];              // Number of steps planned for each bus.
+    int steps_done[MAX_BUSES];             // Number of those carried out.
+    int seats_left[MAX_BUSES];             // Seats of each bus not taken once its planned steps are done.
+    double bus_leave[MAX_BUSES];           // Time the departure of each bus is scheduled for, or -1.
+    int planning[MAX_BUSES];               // The buses with planned steps not carried out yet.
+    int num_planning;
+    int claimed[MAX_STOPS + 1];            // Number of people at the head of the queue at each stop who are being loaded or planned to board a bus.
+    // Arrivals, with lazy_arrivals.
+    double next_arrival[MAX_STOPS + 1];    // Time of the next arrival at each stop (from 1; entry 0 is INFINITY).
+    long long arrival_event[MAX_STOPS + 1]; // Handle of the pending arrival event of each stop with a bus.
+};
+
+/* Default parameters and initial state of the model, with the network of the problem statement built in: the bus goes from the car rental
+   to terminal 1, terminal 2 and back. */
+const struct model model_default = {
+    .num_buses = 1,
+    .bus_capacity = 20,
+    .unload_time_lower = 16,
+    .unload_time_upper = 24,
+    .load_time_lower = 15,
+    .load_time_upper = 25,
+    .bus_speed = 30.0 / 60.0 / 60.0,
+    .length_simulation = 80.0 * 60.0 * 60.0,
+    .bus_wait_time = 5.0 * 60.0,
+    .arrival_scale = 1.0,
+    .num_stops = 3,
+    .depot = RENTAL_ID,
+    .stop_name = {[RENTAL_ID] = "Rental", [TERMINAL_1_ID] = "Terminal 1", [TERMINAL_2_ID] = "Terminal 2"},
+    .arrival_rate = {[RENTAL_ID] = 24.0 / 60.0 / 60.0, [TERMINAL_1_ID] = 14.0 / 60.0 / 60.0, [TERMINAL_2_ID] = 10.0 / 60.0 / 60.0},
+    .next_stop = {[RENTAL_ID] = TERMINAL_1_ID, [TERMINAL_1_ID] = TERMINAL_2_ID, [TERMINAL_2_ID] = RENTAL_ID},
+    .distance = {[RENTAL_ID] = 4.5, [TERMINAL_1_ID] = 1.0, [TERMINAL_2_ID] = 4.5},
+    .num_destinations = {[RENTAL_ID] = 2, [TERMINAL_1_ID] = 1, [TERMINAL_2_ID] = 1},
+    .destination = {[RENTAL_ID] = {0, TERMINAL_1_ID, TERMINAL_2_ID}, [TERMINAL_1_ID] = {0, RENTAL_ID}, [TERMINAL_2_ID] = {0, RENTAL_ID}},
+    .destination_probability = {[RENTAL_ID] = {0.0, 0.583, 0.417}, [TERMINAL_1_ID] = {0.0, 1.0}, [TERMINAL_2_ID] = {0.0, 1.0}},
+};
+
+/* Parameters that can be set from the command line, in the units of the problem statement (rates per hour, miles per hour, seconds, minutes
+   and hours), with the factor that converts them to the units of struct model. The rates, distances and probabilities named after the car
+   rental and the terminals are those of stops 1 to 3, as in the built-in network. Each takes values in one of the ranges below. */
+#define RANGE_POSITIVE 1    /* More than 0. */
+#define RANGE_NONNEGATIVE 2 /* 0 or more. */
+#define RANGE_PROBABILITY 3 /* From 0 to 1. */
+#define RANGE_FLAG 4        /* 0 or 1. */
+
+struct parameter {
+    const char *name;
+    size_t offset; // Of the field in struct model.
+    int is_int;    // Whether the field is an int rather than a double.
+    double scale;  // Model units per command-line unit.
+    int range;     // RANGE_POSITIVE, RANGE_NONNEGATIVE, RANGE_PROBABILITY or RANGE_FLAG.
+};
+
+const struct parameter parameters[] = {
+    {"num_buses", offsetof(struct model, num_buses), 1, 1.0, RANGE_POSITIVE},
+    {"bus_capacity", offsetof(struct model, bus_capacity), 1, 1.0, RANGE_POSITIVE},
+    {"unload_time_lower", offsetof(struct model, unload_time_lower), 1, 1.0, RANGE_NONNEGATIVE},
+    {"unload_time_upper", offsetof(struct model, unload_time_upper), 1, 1.0, RANGE_NONNEGATIVE},
+    {"load_time_lower", offsetof(struct model, load_time_lower), 1, 1.0, RANGE_NONNEGATIVE},
+    {"load_time_upper", offsetof(struct model, load_time_upper), 1, 1.0, RANGE_NONNEGATIVE},
+    {"bus_speed", offsetof(struct model, bus_speed), 0, 1.0 / 60.0 / 60.0, RANGE_POSITIVE},
+    {"terminal_1_arrival_rate", offsetof(struct model, arrival_rate[TERMINAL_1_ID]), 0, 1.0 / 60.0 / 60.0, RANGE_POSITIVE},
+    {"terminal_2_arrival_rate", offsetof(struct model, arrival_rate[TERMINAL_2_ID]), 0, 1.0 / 60.0 / 60.0, RANGE_POSITIVE},
+    {"rental_arrival_rate", offsetof(struct model, arrival_rate[RENTAL_ID]), 0, 1.0 / 60.0 / 60.0, RANGE_POSITIVE},
+    {"arrival_scale", offsetof(struct model, arrival_scale), 0, 1.0, RANGE_POSITIVE},
+    {"distance_rental_terminal_1", offsetof(struct model, distance[RENTAL_ID]), 0, 1.0, RANGE_POSITIVE},
+    {"distance_terminal_1_terminal_2", offsetof(struct model, distance[TERMINAL_1_ID]), 0, 1.0, RANGE_POSITIVE},
+    {"distance_terminal_2_rental", offsetof(struct model, distance[TERMINAL_2_ID]), 0, 1.0, RANGE_POSITIVE},
+    {"destination_terminal_1_probability", offsetof(struct model, destination_probability[RENTAL_ID][1]), 0, 1.0, RANGE_PROBABILITY},
+    {"destination_terminal_2_probability", offsetof(struct model, destination_probability[RENTAL_ID][2]), 0, 1.0, RANGE_PROBABILITY},
+    {"length_simulation", offsetof(struct model, length_simulation), 0, 60.0 * 60.0, RANGE_POSITIVE},
+    {"bus_wait_time", offsetof(struct model, bus_wait_time), 0, 60.0, RANGE_NONNEGATIVE},
+    {"aggregate_dwell", offsetof(struct model, aggregate_dwell), 1, 1.0, RANGE_FLAG},
+    {"lazy_arrivals", offsetof(struct model, lazy_arrivals), 1, 1.0, RANGE_FLAG},
+};
+#define NUM_PARAMETERS (int)(sizeof parameters / sizeof parameters[0])
+
 FILE *outfile;
+int num_percentiles;              // Number of percentiles of delay, bus stop time and time in system to estimate and report.
+double percentiles[MAX_QUANT];    // Those percentiles, between 0 and 100.
+int detect_warmup;                // Whether to reset the statistics when queue lengths and delays leave their initial transient.
+int event_list = EVLIST_HEAP;     // Event list backend of every simlib context (the results are the same with either).
+
+long long bus_schedule(struct model *m, double time, int type, int bus) /* Schedule an event of type "type" for bus "bus", at its location. */
+{
+    transfer[EVENT_BUS] = bus;
+    transfer[EVENT_LOCATION] = m->bus_location[bus];
+    return event_schedule(time, type);
+}
+
+void bus_board(struct model *m, int bus, double time) /* Put the person in transfer on bus "bus", behind the people bound for the same destination, at time "time". */
+{
+    // The number of people on all the buses is tracked on the timest variable of the bus list, so filest(BUS_LIST(m)) reports it.
+    int seat = m->free_seat[bus], destination = (int)transfer[2];
+    m->free_seat[bus] = m->seat_next[bus][seat];
+    m->rider_arrival[bus][seat] = transfer[1];
+    m->rider_origin[bus][seat] = (char)transfer[3];
+    m->seat_next[bus][seat] = NO_SEAT;
+    if (m->compartment_head[bus][destination] == NO_SEAT)
+        m->compartment_head[bus][destination] = (signed char)seat;
+    else
+        m->seat_next[bus][m->compartment_tail[bus][destination]] = (signed char)seat;
+    m->compartment_tail[bus][destination] = (signed char)seat;
+    m->riders[bus]++;
+    timest_at(++m->total_riders, TIM_VAR + BUS_LIST(m), time);
+}
+
+int bus_alight(struct model *m, int bus, int location, double time) /* Take the foremost person bound for "location" off bus "bus" into transfer at time "time", if there is one. */
+{
+    int seat = m->compartment_head[bus][location];
+    if (seat == NO_SEAT)
+        return 0;
+    transfer[1] = m->rider_arrival[bus][seat];
+    transfer[2] = location;
+    transfer[3] = m->rider_origin[bus][seat];
+    // Free the seat.
+    m->compartment_head[bus][location] = m->seat_next[bus][seat];
+    m->seat_next[bus][seat] = m->free_seat[bus];
+    m->free_seat[bus] = (signed char)seat;
+    m->riders[bus]--;
+    timest_at(--m->total_riders, TIM_VAR + BUS_LIST(m), time);
+    return 1;
+}
+
+void bus_dock(struct model *m, int bus) /* Add bus "bus" to the buses at its location. */
+{
+    m->bus_next_docked[bus] = m->docked[m->bus_location[bus]];
+    m->docked[m->bus_location[bus]] = bus;
+}
+
+void bus_undock(struct model *m, int bus) /* Remove bus "bus" from the buses at its location. */
+{
+    int *link = &m->docked[m->bus_location[bus]];
+    while (*link != bus)
+        link = &m->bus_next_docked[*link];
+    *link = m->bus_next_docked[bus];
+}
+
+double departure_time(const struct model *m, int bus, double time) /* Return when bus "bus", done at its location at time "time", leaves: once it has been there for bus_wait_time. */
+{
+    double wait_time = (time - m->bus_arrive_time[bus] > m->bus_wait_time) ? 0 : m->bus_wait_time - (time - m->bus_arrive_time[bus]);
+    return time + wait_time;
+}
+
+void schedule_departure(struct model *m, int bus) /* Schedule the departure of bus "bus" once it has been at its location for bus_wait_time, or now if it already has. */
+{
+    m->bus_departure[bus] = bus_schedule(m, departure_time(m, bus, sim_time), EVENT_BUS_DEPARTURE, bus);
+}
+
+void start_loading(struct model *m, int bus) /* Have bus "bus" start loading the first person at its location no bus is loading yet. */
+{
+    // A bus loads one person at a time, and a person is loaded by one bus, so a bus only starts while list_size > claimed at its location.
+    bus_schedule(m, sim_time + uniform(m->load_time_lower, m->load_time_upper, STREAM_LOADING), EVENT_LOAD_PERSON, bus);
+    m->claimed[m->bus_location[bus]]++;
+    m->bus_loading[bus] = 1;
+}
+
+void plan_step(struct model *m, int bus, double time) /* Add a step ending at time "time" to the plan of bus "bus". */
+{
+    if (m->steps_done[bus] == m->num_steps[bus])
+        m->planning[m->num_planning++] = bus;
+    m->step_end[bus][m->num_steps[bus]++] = time;
+}
+
+void plan_done(struct model *m, int bus) /* Drop bus "bus", whose planned steps are all done, from the buses with steps to carry out. */
+{
+    int i;
+    for (i = 0; m->planning[i] != bus; i++)
+        ;
+    m->planning[i] = m->planning[--m->num_planning];
+}
+
+double step_start(const struct model *m, int bus, int step) /* Return when step "step" of bus "bus" starts: when the step before ends, or when the bus arrived. */
+{
+    return step > 0 ? m->step_end[bus][step - 1] : m->bus_arrive_time[bus];
+}
+
+double bus_free(const struct model *m, int bus) /* Return when bus "bus" could start another step: after its planned steps, and not before now. */
+{
+    double time = step_start(m, bus, m->num_steps[bus]);
+    return time > sim_time ? time : sim_time;
+}
 
-void person_arrive(int location) // Event function for arrival of a person to a location.
+void plan_loading(struct model *m, int location) /* Share the loading of the people waiting at "location" among the buses there, and move their departures to match (with aggregate_dwell). */
 {
-    int destination;
-    // Schedule arrival of next person in this location and determine the destination of this person.
-    switch (location) {
-    case RENTAL_ID:
-        event_schedule(sim_time + expon(1.0 / rental_arrival_rate, STREAM_INTERARRIVAL_RENTAL), EVENT_PERSON_ARRIVAL_RENTAL);
-        destination = (uniform(0.0, 1.0, STREAM_DESTINATION) < destination_terminal_1_probability) ? TERMINAL_1_ID : TERMINAL_2_ID;
-        break;
-    case TERMINAL_1_ID:
-        event_schedule(sim_time + expon(1.0 / terminal_1_arrival_rate, STREAM_INTERARRIVAL_TERMINAL_1), EVENT_PERSON_ARRIVAL_TERMINAL_1);
-        destination = RENTAL_ID;
-        break;
-    case TERMINAL_2_ID:
-        event_schedule(sim_time + expon(1.0 / terminal_2_arrival_rate, STREAM_INTERARRIVAL_TERMINAL_2), EVENT_PERSON_ARRIVAL_TERMINAL_2);
-        destination = RENTAL_ID;
-        break;
+    // Every person goes to the bus with a seat left that can start loading them first, as with person_load, where the first bus done with
+    // its previous step loads the next person. A person planned on another bus is moved over if this one would start loading them sooner.
+    int bus, first, last;
+    for (;;) {
+        first = last = NO_BUS;
+        for (bus = m->docked[location]; bus != NO_BUS; bus = m->bus_next_docked[bus]) {
+            if (m->seats_left[bus] > 0 && (first == NO_BUS || bus_free(m, bus) < bus_free(m, first)))
+                first = bus;
+            if (m->num_steps[bus] > m->num_unloading[bus] && m->num_steps[bus] > m->steps_done[bus] &&
+                (last == NO_BUS || step_start(m, bus, m->num_steps[bus] - 1) > step_start(m, last, m->num_steps[last] - 1)))
+                last = bus;
+        }
+        if (first == NO_BUS)
+            break;
+        if (list_size[location] > m->claimed[location])
+            m->claimed[location]++;
+        else if (last != NO_BUS && step_start(m, last, m->num_steps[last] - 1) > bus_free(m, first)) {
+            if (--m->num_steps[last] == m->steps_done[last])
+                plan_done(m, last);
+            m->seats_left[last]++;
+        } else
+            break;
+        plan_step(m, first, bus_free(m, first) + uniform(m->load_time_lower, m->load_time_upper, STREAM_LOADING));
+        m->seats_left[first]--;
+    }
+    for (bus = m->docked[location]; bus != NO_BUS; bus = m->bus_next_docked[bus])
+        if (departure_time(m, bus, step_start(m, bus, m->num_steps[bus])) != m->bus_leave[bus]) {
+            if (m->bus_leave[bus] >= 0.0)
+                event_cancel_handle(m->bus_departure[bus]);
+            m->bus_leave[bus] = departure_time(m, bus, step_start(m, bus, m->num_steps[bus]));
+            m->bus_departure[bus] = bus_schedule(m, m->bus_leave[bus], EVENT_BUS_DEPARTURE, bus);
+        }
+}
+
+void bus_plan(struct model *m, int bus) /* Plan the stop of bus "bus", which has just arrived, and schedule its departure (with aggregate_dwell). */
+{
+    // The steps are those person_unload and person_load would take, with the same draws: one unloading time per person bound here, and one
+    // more, in which nobody gets off, if people bound elsewhere stay on; then one loading time per person plan_loading() gives the bus.
+    // They are carried out by do_steps() once the clock has passed them, so the statistics see every person at the time they get on or off.
+    // With one bus the draws also come in the same order, so the results are identical. Buses at stops at the same time share the loading
+    // and unloading streams and draw from them in another order than the events would, so with several buses the results only agree in
+    // distribution.
+    int location = m->bus_location[bus], seat, alighting = 0;
+    m->num_steps[bus] = m->steps_done[bus] = 0;
+    for (seat = m->compartment_head[bus][location]; seat != NO_SEAT; seat = m->seat_next[bus][seat])
+        alighting++;
+    m->num_unloading[bus] = alighting + (m->riders[bus] > alighting);
+    for (seat = 0; seat < m->num_unloading[bus]; seat++)
+        plan_step(m, bus, step_start(m, bus, seat) + uniform(m->unload_time_lower, m->unload_time_upper, STREAM_UNLOADING));
+    m->seats_left[bus] = m->bus_capacity - (m->riders[bus] - alighting);
+    m->bus_leave[bus] = -1.0;
+    plan_loading(m, location);
+}
+
+void do_step(struct model *m, int bus) /* Carry out the next planned step of bus "bus", as of the time it ends. */
+{
+    int location = m->bus_location[bus], step = m->steps_done[bus]++;
+    double time = m->step_end[bus][step];
+    if (step < m->num_unloading[bus]) {
+        if (bus_alight(m, bus, location, time))
+            sampst_at(time - transfer[1], SVAR_TIME_IN_SYSTEM(m, (int)transfer[3]), time);
+    } else {
+        list_remove_at(FIRST, location, time);
+        m->claimed[location]--;
+        sampst_at(time - transfer[1], SVAR_DELAY(m, location), time);
+        bus_board(m, bus, time);
+    }
+    if (m->steps_done[bus] == m->num_steps[bus])
+        plan_done(m, bus);
+}
+
+void do_steps(struct model *m) /* Carry out the planned steps of all the buses that end by now, in order of time, keeping the event just taken by timing() in transfer. */
+{
+    double event[EVENT_LOCATION + 1];
+    int i, bus, next;
+    memcpy(event, transfer, sizeof event);
+    while (m->num_planning > 0) {
+        next = m->planning[0];
+        for (i = 1; i < m->num_planning; i++) {
+            bus = m->planning[i];
+            if (m->step_end[bus][m->steps_done[bus]] < m->step_end[next][m->steps_done[next]])
+                next = bus;
+        }
+        if (m->step_end[next][m->steps_done[next]] > sim_time)
+            break;
+        do_step(m, next);
+    }
+    memcpy(transfer, event, sizeof event);
+}
+
+void arrivals_until(struct model *m, double time) /* Put the people who arrive at the stops by time "time" in their queues (with lazy_arrivals). */
+{
+    // Nobody looks at the queue of a stop without a bus, so its people are only put in it when a bus arrives, or at the end of the run, each
+    // as of their arrival time so that the queue length statistics are the same. They are taken in order of time across the stops, as the
+    // events of person_arrive would have them, since all the stops draw their destinations from one stream.
+    int stop, next;
+    double time_of_arrival;
+    for (;;) {
+        next = 0;
+        for (stop = 1; stop <= m->num_stops; stop++)
+            if (m->next_arrival[stop] < m->next_arrival[next])
+                next = stop;
+        if (m->next_arrival[next] > time)
+            break;
+        time_of_arrival = m->next_arrival[next];
+        transfer[1] = time_of_arrival;
+        transfer[2] = m->destination[next][random_alias(&m->destination_table[next], STREAM_DESTINATION)];
+        transfer[3] = next;
+        list_file_at(LAST, next, time_of_arrival);
+        m->next_arrival[next] = time_of_arrival + expon(1.0 / (m->arrival_rate[next] * m->arrival_scale), STREAM_INTERARRIVAL(next));
     }
+}
 
-    // Add the person to the queue of this location.
-    transfer[1] = sim_time;
-    transfer[2] = destination;
-    transfer[3] = location;
-    list_file(LAST, location);
+void schedule_arrival(struct model *m, int location) /* Schedule the next arrival at "location" as an event, for the buses there (with lazy_arrivals). */
+{
+    if (m->arrival_rate[location] > 0.0) {
+        transfer[EVENT_STOP] = location;
+        transfer[EVENT_LOCATION] = location;
+        m->arrival_event[location] = event_schedule(m->next_arrival[location], EVENT_PERSON_ARRIVAL);
+    }
+}
+
+void person_arrive(struct model *m, int location) // Event function for arrival of a person to a location.
+{
+    int destination, bus;
+    if (m->lazy_arrivals) {
+        // Put this person in the queue with the people who arrived at the other stops before, and schedule the next arrival here.
+        arrivals_until(m, sim_time);
+        schedule_arrival(m, location);
+    } else {
+        // Schedule arrival of next person in this location and determine the destination of this person.
+        transfer[EVENT_STOP] = location;
+        transfer[EVENT_LOCATION] = location;
+        event_schedule(sim_time + expon(1.0 / (m->arrival_rate[location] * m->arrival_scale), STREAM_INTERARRIVAL(location)), EVENT_PERSON_ARRIVAL);
+        destination = m->destination[location][random_alias(&m->destination_table[location], STREAM_DESTINATION)];
+
+        // Add the person to the queue of this location.
+        transfer[1] = sim_time;
+        transfer[2] = destination;
+        transfer[3] = location;
+        list_append(location);
+    }
 
-    // If a bus is at this location, schedule loading of this person
-    if (bus_arrived && !is_unloading && current_bus_location == location && list_size[BUS_ID] < bus_capacity && list_size[location] > 0) {
-        event_schedule(sim_time + uniform(load_time_lower, load_time_upper, STREAM_LOADING), EVENT_LOAD_PERSON);
-        // Cancel bus departure if it is scheduled.
-        event_cancel(EVENT_BUS_DEPARTURE);
+    // With aggregate_dwell, a bus at this location with a seat left plans to load this person.
+    if (m->aggregate_dwell) {
+        plan_loading(m, location);
+        return;
     }
+
+    // If a bus at this location is neither unloading nor loading and has room, schedule loading of this person
+    for (bus = m->docked[location]; bus != NO_BUS; bus = m->bus_next_docked[bus])
+        if (!m->bus_unloading[bus] && !m->bus_loading[bus] && m->riders[bus] < m->bus_capacity) {
+            start_loading(m, bus);
+            // Cancel bus departure if it is scheduled.
+            event_cancel_handle(m->bus_departure[bus]);
+            break;
+        }
 }
 
-void bus_arrive(int location) // Event function for arrival of a bus in a location. Because of the nature of unloading and loading, this event only starts unloading and loading processes and starts a timer.
+void bus_arrive(struct model *m, int bus) // Event function for arrival of a bus in a location. Because of the nature of unloading and loading, this event only starts unloading and loading processes and starts a timer.
 {
-    last_bus_arrive_time = sim_time;
-    bus_arrived = 1;
+    int location = m->bus_location[bus];
+    m->bus_arrive_time[bus] = sim_time;
+    m->bus_arrived[bus] = 1;
+    // With lazy_arrivals, bring the queue up to now, and have the people arriving while the bus is here arrive through events.
+    if (m->lazy_arrivals) {
+        arrivals_until(m, sim_time);
+        if (m->docked[location] == NO_BUS)
+            schedule_arrival(m, location);
+    }
+    bus_dock(m, bus);
+    // With aggregate_dwell, plan the whole stop now.
+    if (m->aggregate_dwell) {
+        bus_plan(m, bus);
+        return;
+    }
     // If people on bus
-    if (list_size[BUS_ID] > 0) {
+    if (m->riders[bus] > 0) {
         // Start unloading process.
-        event_schedule(sim_time + uniform(unload_time_lower, unload_time_upper, STREAM_UNLOADING), EVENT_UNLOAD_PERSON);
-        is_unloading = 1;
+        bus_schedule(m, sim_time + uniform(m->unload_time_lower, m->unload_time_upper, STREAM_UNLOADING), EVENT_UNLOAD_PERSON, bus);
+        m->bus_unloading[bus] = 1;
         // If no people on bus but people in queue at this location
-    } else if (list_size[location] > 0 && list_size[BUS_ID] < bus_capacity) {
+    } else if (list_size[location] > m->claimed[location] && m->riders[bus] < m->bus_capacity) {
         // Start loading process.
-        event_schedule(sim_time + uniform(load_time_lower, load_time_upper, STREAM_LOADING), EVENT_LOAD_PERSON);
+        start_loading(m, bus);
     } else {
         // Make sure double departure never happens
-        event_cancel(EVENT_BUS_DEPARTURE);
+        event_cancel_handle(m->bus_departure[bus]);
         // If no people in queue and no people on bus, schedule bus departure.
-        current_bus_wait_time = (sim_time - last_bus_arrive_time > bus_wait_time) ? 0 : bus_wait_time - (sim_time - last_bus_arrive_time);
-        event_schedule(sim_time + current_bus_wait_time, EVENT_BUS_DEPARTURE);
+        schedule_departure(m, bus);
     }
 }
 
-void bus_depart(int location) // Event function for departure of a bus from a location. This function schedules the arrival of the bus to the next location.
+void bus_depart(struct model *m, int bus) // Event function for departure of a bus from a location. This function schedules the arrival of the bus to the next location.
 {
     // Schedule arrival of the bus to the next location.
-    double next_distance;
-    switch (location) {
-    case RENTAL_ID:
-        next_distance = distance_rental_terminal_1;
-        break;
-    case TERMINAL_1_ID:
-        next_distance = distance_terminal_1_terminal_2;
-        break;
-    case TERMINAL_2_ID:
-        next_distance = distance_terminal_2_rental;
-        break;
-    }
-    event_schedule(sim_time + (next_distance / bus_speed), EVENT_BUS_ARRIVAL);
-    current_bus_location = (location == RENTAL_ID) ? TERMINAL_1_ID : (location == TERMINAL_1_ID) ? TERMINAL_2_ID
-                                                                                                 : RENTAL_ID;
-    bus_arrived = 0;
+    int location = m->bus_location[bus];
+    bus_undock(m, bus);
+    // With lazy_arrivals, the last bus to leave takes the arrival event of this location with it; the next arrival time is kept.
+    if (m->lazy_arrivals && m->docked[location] == NO_BUS && m->arrival_rate[location] > 0.0)
+        event_cancel_handle(m->arrival_event[location]);
+    m->bus_location[bus] = m->next_stop[location];
+    m->bus_arrived[bus] = 0;
+    bus_schedule(m, sim_time + (m->distance[location] / m->bus_speed), EVENT_BUS_ARRIVAL, bus);
     // Record time the bus was at this location.
-    sampst(sim_time - last_bus_arrive_time, location + 5);
+    sampst(sim_time - m->bus_arrive_time[bus], SVAR_STOP_TIME(m, location));
     // Record lap time
-    if (location == RENTAL_ID) {
-        if (last_bus_at_rental != 0.0) {
-            sampst(sim_time - last_bus_at_rental, 10);
+    if (location == m->depot) {
+        if (m->bus_at_depot[bus] != 0.0) {
+            sampst(sim_time - m->bus_at_depot[bus], SVAR_LAP(m));
         }
-        last_bus_at_rental = sim_time;
+        m->bus_at_depot[bus] = sim_time;
     }
 }
 
-void person_unload(int location) // Event function for unloading a person from the bus. This function schedules the unloading of the next person if there are still people on the bus.
+void person_unload(struct model *m, int bus) // Event function for unloading a person from the bus. This function schedules the unloading of the next person if there are still people on the bus.
 {
-    if (bus_arrived) {
+    int location = m->bus_location[bus];
+    if (m->bus_arrived[bus]) {
         // Make sure double departure never happens
-        event_cancel(EVENT_BUS_DEPARTURE);
-        // Only unload person whose destination is this location.
-        // Need to go through list to find foremost person whose destination is this location.
-        int i = list_size[BUS_ID];
-        int found = 0;
-        while (i > 0 && !found) {
-            list_remove(FIRST, BUS_ID);
-            if (transfer[2] == location) {
-                found = 1;
-                // Record time this person was in system.
-                sampst(sim_time - transfer[1], transfer[3] + 10);
-            } else {
-                list_file(LAST, BUS_ID);
-            }
-            i--;
+        event_cancel_handle(m->bus_departure[bus]);
+        // Only unload the foremost person whose destination is this location.
+        int found = bus_alight(m, bus, location, sim_time);
+        if (found) {
+            // Record time this person was in system.
+            sampst(sim_time - transfer[1], SVAR_TIME_IN_SYSTEM(m, (int)transfer[3]));
         }
         // If there are still people on the bus, schedule unloading of the next person.
-        if (found && list_size[BUS_ID] > 0) {
-            event_schedule(sim_time + uniform(unload_time_lower, unload_time_upper, STREAM_UNLOADING), EVENT_UNLOAD_PERSON);
-        } else if (list_size[location] > 0 && list_size[BUS_ID] < bus_capacity) {
+        if (found && m->riders[bus] > 0) {
+            bus_schedule(m, sim_time + uniform(m->unload_time_lower, m->unload_time_upper, STREAM_UNLOADING), EVENT_UNLOAD_PERSON, bus);
+        } else if (list_size[location] > m->claimed[location] && m->riders[bus] < m->bus_capacity) {
             // If people in queue at this location, start loading process.
-            event_schedule(sim_time + uniform(load_time_lower, load_time_upper, STREAM_LOADING), EVENT_LOAD_PERSON);
-            is_unloading = 0;
+            start_loading(m, bus);
+            m->bus_unloading[bus] = 0;
         } else {
             // If no people in queue and no people on bus, schedule bus departure.
-            current_bus_wait_time = (sim_time - last_bus_arrive_time > bus_wait_time) ? 0 : bus_wait_time - (sim_time - last_bus_arrive_time);
-            event_schedule(sim_time + current_bus_wait_time, EVENT_BUS_DEPARTURE);
-            is_unloading = 0;
+            schedule_departure(m, bus);
+            m->bus_unloading[bus] = 0;
         }
     }
 }
 
-void person_load(int location) // Event function for loading a person to the bus. This function schedules the loading of the next person if there are still people in the queue.
+void person_load(struct model *m, int bus) // Event function for loading a person to the bus. This function schedules the loading of the next person if there are still people in the queue.
 {
-    if (bus_arrived) {
+    int location = m->bus_location[bus];
+    if (m->bus_arrived[bus]) {
         // Make sure double departure never happens
-        event_cancel(EVENT_BUS_DEPARTURE);
+        event_cancel_handle(m->bus_departure[bus]);
+        m->bus_loading[bus] = 0;
         // If bus is not full
-        if (list_size[BUS_ID] < bus_capacity && list_size[location] > 0) {
+        if (m->riders[bus] < m->bus_capacity && list_size[location] > 0) {
             // Load one person to the bus.
-            list_remove(FIRST, location);
+            list_pop_front(location);
+            m->claimed[location]--;
             // Record delay of this person.
-            sampst(sim_time - transfer[1], location);
+            sampst(sim_time - transfer[1], SVAR_DELAY(m, location));
             // Add this person to the bus.
-            list_file(LAST, BUS_ID);
-            // If there are still people in the queue, schedule loading of the next person
-            if (list_size[location] > 0 && list_size[BUS_ID] < bus_capacity) {
-                event_schedule(sim_time + uniform(load_time_lower, load_time_upper, STREAM_LOADING), EVENT_LOAD_PERSON);
+            bus_board(m, bus, sim_time);
+            // If there are still people in the queue no other bus is loading, schedule loading of the next person
+            if (list_size[location] > m->claimed[location] && m->riders[bus] < m->bus_capacity) {
+                start_loading(m, bus);
             } else {
-                current_bus_wait_time = (sim_time - last_bus_arrive_time > bus_wait_time) ? 0 : bus_wait_time - (sim_time - last_bus_arrive_time);
-                event_schedule(sim_time + current_bus_wait_time, EVENT_BUS_DEPARTURE);
+                schedule_departure(m, bus);
             }
         } else {
             // If no people in queue and no people on bus, schedule bus departure.
-            current_bus_wait_time = (sim_time - last_bus_arrive_time > bus_wait_time) ? 0 : bus_wait_time - (sim_time - last_bus_arrive_time);
-            event_schedule(sim_time + current_bus_wait_time, EVENT_BUS_DEPARTURE);
+            schedule_departure(m, bus);
         }
     }
 }
 
-void report(void) /* Report generator function. */
+void stop_label(const struct model *m, int stop, char label[STOP_NAME]) /* Place the name of stop "stop" in lowercase, as it reads inside a statistic name, in label. */
+{
+    int i;
+    for (i = 0; m->stop_name[stop][i] != '\0'; i++)
+        label[i] = (char)tolower((unsigned char)m->stop_name[stop][i]);
+    label[i] = '\0';
+}
+
+int percentile_var(const struct model *m, int i) /* Return the sampst variable of percentile row i: the delay, then the bus stop time, then the time in system at each stop. */
 {
+    int stop = i % m->num_stops + 1;
+    return i < m->num_stops ? SVAR_DELAY(m, stop) : i < 2 * m->num_stops ? SVAR_STOP_TIME(m, stop) : SVAR_TIME_IN_SYSTEM(m, stop);
+}
+
+void report_percentiles(const struct model *m) /* Report the estimated percentiles of delay, bus stop time and time in system. */
+{
+    const char *kinds[3] = {"Delay", "Bus stop time", "Time in system"};
+    char label[16], stop[STOP_NAME], name[64];
+    int i, j;
+
+    fprintf(outfile, "\n\n\n\n%-36s", "Statistic");
+    for (j = 0; j < num_percentiles; j++) {
+        snprintf(label, sizeof label, "p%g", percentiles[j]);
+        fprintf(outfile, "%15s", label);
+    }
+    for (i = 0; i < 3 * m->num_stops; i++) {
+        stop_label(m, i % m->num_stops + 1, stop);
+        snprintf(name, sizeof name, "%s, %s", kinds[i / m->num_stops], stop);
+        fprintf(outfile, i % m->num_stops == 0 ? "\n\n%-36s" : "\n%-36s", name);
+        for (j = 0; j < num_percentiles; j++)
+            fprintf(outfile, "%15.3f", sampst_quantile(percentile_var(m, i), percentiles[j] / 100.0));
+    }
+}
+
+void report_warmup(void) /* Report when the statistics were reset at the end of the warm-up. */
+{
+    if (warmup_end() >= 0.0)
+        fprintf(outfile, "Warm-up detected, statistics reset at %.3f hours\n", warmup_end() / 60.0 / 60.0);
+    else
+        fprintf(outfile, "No end of the warm-up detected, statistics kept from time 0\n");
+}
+
+void report(const struct model *m) /* Report generator function. */
+{
+    int stop;
+
     // Report average and maximum queue length for each location through filest that reads from lists
     fprintf(outfile, "\n\nLocation     Average queue length     Maximum queue length");
-    filest(RENTAL_ID);
-    fprintf(outfile, "\n\nRental%27.3f%25.3f", transfer[1], transfer[2]);
-    filest(TERMINAL_1_ID);
-    fprintf(outfile, "\nTerminal 1%23.3f%25.3f", transfer[1], transfer[2]);
-    filest(TERMINAL_2_ID);
-    fprintf(outfile, "\nTerminal 2%23.3f%25.3f", transfer[1], transfer[2]);
+    for (stop = 1; stop <= m->num_stops; stop++) {
+        filest(stop);
+        fprintf(outfile, "%s%s%*.3f%25.3f", stop == 1 ? "\n\n" : "\n", m->stop_name[stop], 33 - (int)strlen(m->stop_name[stop]), transfer[1], transfer[2]);
+    }
 
     // Report average and maximum delay in each location through sampst that reads from sampst
     fprintf(outfile, "\n\n\n\nLocation           Average delay            Maximum delay");
-    sampst(0.0, -RENTAL_ID);
-    fprintf(outfile, "\n\nRental%26.3f%25.3f", transfer[1], transfer[3]);
-    sampst(0.0, -TERMINAL_1_ID);
-    fprintf(outfile, "\nTerminal 1%22.3f%25.3f", transfer[1], transfer[3]);
-    sampst(0.0, -TERMINAL_2_ID);
-    fprintf(outfile, "\nTerminal 2%22.3f%25.3f", transfer[1], transfer[3]);
+    for (stop = 1; stop <= m->num_stops; stop++) {
+        sampst(0.0, -SVAR_DELAY(m, stop));
+        fprintf(outfile, "%s%s%*.3f%25.3f", stop == 1 ? "\n\n" : "\n", m->stop_name[stop], 32 - (int)strlen(m->stop_name[stop]), transfer[1], transfer[3]);
+    }
 
     // Report average and maximum num of people in bus (which is just the queue length of bus)
     fprintf(outfile, "\n\n\n\nAverage number of people on bus      Maximum number of people on bus");
-    filest(BUS_ID);
+    filest(BUS_LIST(m));
     fprintf(outfile, "\n\n%.3f%38.3f", transfer[1], transfer[2]);
 
     // Report average maximum minimum time bus is stopped at each location
     fprintf(outfile, "\n\n\n\nLocation     Average bus stop time        Maximum bus stop time       Minimum bus stop time");
-    sampst(0.0, -(RENTAL_ID + 5));
-    fprintf(outfile, "\n\nRental%28.3f%29.3f%28.3f", transfer[1], transfer[3], transfer[4]);
-    sampst(0.0, -(TERMINAL_1_ID + 5));
-    fprintf(outfile, "\nTerminal 1%24.3f%29.3f%28.3f", transfer[1], transfer[3], transfer[4]);
-    sampst(0.0, -(TERMINAL_2_ID + 5));
-    fprintf(outfile, "\nTerminal 2%24.3f%29.3f%28.3f", transfer[1], transfer[3], transfer[4]);
-
-    // Report average maximum minimum time bus goes from rental to rental
+    for (stop = 1; stop <= m->num_stops; stop++) {
+        sampst(0.0, -SVAR_STOP_TIME(m, stop));
+        fprintf(outfile, "%s%s%*.3f%29.3f%28.3f", stop == 1 ? "\n\n" : "\n", m->stop_name[stop], 34 - (int)strlen(m->stop_name[stop]), transfer[1], transfer[3],
+                transfer[4]);
+    }
+
+    // Report average maximum minimum time bus goes from the depot to the depot
     fprintf(outfile, "\n\n\n\nAverage bus lap time      Maximum bus lap time       Minimum bus lap time");
-    sampst(0.0, -10);
+    sampst(0.0, -SVAR_LAP(m));
     fprintf(outfile, "\n\n%.3f%26.3f%28.3f", transfer[1], transfer[3], transfer[4]);
 
     // Report average maximum minimum time in system for each location
     fprintf(outfile, "\n\n\n\nLocation     Average time in system     Maximum time in system       Minimum time in system");
-    sampst(0.0, -(RENTAL_ID + 10));
-    fprintf(outfile, "\n\nRental%29.3f%27.3f%29.3f", transfer[1], transfer[3], transfer[4]);
-    sampst(0.0, -(TERMINAL_1_ID + 10));
-    fprintf(outfile, "\nTerminal 1%25.3f%27.3f%29.3f", transfer[1], transfer[3], transfer[4]);
-    sampst(0.0, -(TERMINAL_2_ID + 10));
-    fprintf(outfile, "\nTerminal 2%25.3f%27.3f%29.3f", transfer[1], transfer[3], transfer[4]);
+    for (stop = 1; stop <= m->num_stops; stop++) {
+        sampst(0.0, -SVAR_TIME_IN_SYSTEM(m, stop));
+        fprintf(outfile, "%s%s%*.3f%27.3f%29.3f", stop == 1 ? "\n\n" : "\n", m->stop_name[stop], 35 - (int)strlen(m->stop_name[stop]), transfer[1], transfer[3],
+                transfer[4]);
+    }
+
+    // Report the percentiles asked for.
+    if (num_percentiles > 0)
+        report_percentiles(m);
 }
 
-int main() /* Main function. */
+int in_range(double x, int range) /* Return whether x is a finite value in range "range" (one of the RANGE_ values). */
 {
-    /* Open output files. */
+    if (!isfinite(x))
+        return 0;
+    switch (range) {
+    case RANGE_POSITIVE:
+        return x > 0.0;
+    case RANGE_NONNEGATIVE:
+        return x >= 0.0;
+    case RANGE_PROBABILITY:
+        return x >= 0.0 && x <= 1.0;
+    default:
+        return x == 0.0 || x == 1.0;
+    }
+}
 
-    outfile = fopen("carrental.out", "w");
+int set_parameter(struct model *m, const char *assignment) /* Set a parameter of "m" from "name=value"; return 0 if there is no such parameter or the value is not a number or out of range. */
+{
+    const char *value = strchr(assignment, '=');
+    char *end;
+    double x;
+    int i;
 
-    /* Write report heading and input parameters. */
+    if (value == NULL)
+        return 0;
+    for (i = 0; i < NUM_PARAMETERS; i++)
+        if (strlen(parameters[i].name) == (size_t)(value - assignment) && strncmp(parameters[i].name, assignment, value - assignment) == 0)
+            break;
+    x = strtod(value + 1, &end);
+    if (i == NUM_PARAMETERS || end == value + 1 || *end != '\0' || !in_range(x, parameters[i].range) ||
+        (parameters[i].is_int && x > (double)INT_MAX))
+        return 0;
+    if (parameters[i].is_int)
+        *(int *)((char *)m + parameters[i].offset) = (int)x;
+    else
+        *(double *)((char *)m + parameters[i].offset) = x * parameters[i].scale;
+    // The destinations of rental customers are complementary.
+    if (parameters[i].offset == offsetof(struct model, destination_probability[RENTAL_ID][1]))
+        m->destination_probability[RENTAL_ID][2] = 1.0 - m->destination_probability[RENTAL_ID][1];
+    else if (parameters[i].offset == offsetof(struct model, destination_probability[RENTAL_ID][2]))
+        m->destination_probability[RENTAL_ID][1] = 1.0 - m->destination_probability[RENTAL_ID][2];
+    // The state of the fleet has room for MAX_BUSES buses of MAX_SEATS seats.
+    return m->num_buses >= 1 && m->num_buses <= MAX_BUSES && m->bus_capacity >= 1 && m->bus_capacity <= MAX_SEATS;
+}
 
-    fprintf(outfile, "Car Rental Air Terminals model\n\n");
+int bounds_ordered(const struct model *m) /* Return whether the lower bounds of the unload and load times of "m" are not above the upper ones. */
+{
+    // Checked once all the parameters are set, since a lower and an upper bound may be raised one after the other.
+    return m->unload_time_lower <= m->unload_time_upper && m->load_time_lower <= m->load_time_upper;
+}
+
+int load_network(struct model *m, const char *path) /* Replace the route network of "m" with the one in file "path"; return 0 and say why on stderr if it cannot be used. */
+{
+    // One statement per line, blank lines and lines from '#' ignored:
+    //   stop <arrivals per hour> <name>   the stops are numbered 1, 2, ... in the order of these lines
+    //   leg <from> <to> <miles>          the bus drives from stop "from" to stop "to"; every stop has one leg out
+    //   dest <from> <to> <probability>   people arriving at "from" go to "to" with this probability
+    //   depot <stop>                     the buses start here and their laps are timed here (stop 1 if not given)
+    FILE *file = fopen(path, "r");
+    char line[CSV_LINE], keyword[16];
+    int line_number = 0, from, to, stop, n, visited;
+    double x;
+
+    if (file == NULL) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return 0;
+    }
+    m->num_stops = 0;
+    m->depot = 1;
+    memset(m->next_stop, 0, sizeof m->next_stop);
+    memset(m->num_destinations, 0, sizeof m->num_destinations);
+    while (fgets(line, sizeof line, file) != NULL) {
+        line[strcspn(line, "#\r\n")] = '\0';
+        line_number++;
+        if (sscanf(line, "%15s%n", keyword, &n) != 1)
+            continue;
+        if (strcmp(keyword, "stop") == 0 && m->num_stops < MAX_STOPS && sscanf(line + n, "%lf %31[^\n]", &x, m->stop_name[m->num_stops + 1]) == 2 && x >= 0.0) {
+            m->arrival_rate[++m->num_stops] = x / 60.0 / 60.0;
+        } else if (strcmp(keyword, "leg") == 0 && sscanf(line + n, "%d %d %lf", &from, &to, &x) == 3 && from >= 1 && from <= m->num_stops && to >= 1 &&
+                   to <= m->num_stops && m->next_stop[from] == 0 && x > 0.0) {
+            m->next_stop[from] = to;
+            m->distance[from] = x;
+        } else if (strcmp(keyword, "dest") == 0 && sscanf(line + n, "%d %d %lf", &from, &to, &x) == 3 && from >= 1 && from <= m->num_stops && to >= 1 &&
+                   to <= m->num_stops && m->num_destinations[from] < MAX_STOPS && x > 0.0) {
+            m->destination[from][++m->num_destinations[from]] = to;
+            m->destination_probability[from][m->num_destinations[from]] = x;
+        } else if (strcmp(keyword, "depot") == 0 && sscanf(line + n, "%d", &stop) == 1 && stop >= 1 && stop <= m->num_stops) {
+            m->depot = stop;
+        } else {
+            fprintf(stderr, "%s:%d: bad line (or more than %d stops, or a second leg out of a stop)\n", path, line_number, MAX_STOPS);
+            fclose(file);
+            return 0;
+        }
+    }
+    fclose(file);
+
+    // The buses go round a single loop through every stop.
+    if (m->num_stops == 0) {
+        fprintf(stderr, "%s: no stops\n", path);
+        return 0;
+    }
+    for (stop = m->depot, visited = 0; visited < m->num_stops; visited++) {
+        stop = m->next_stop[stop];
+        if (stop == 0 || stop == m->depot)
+            break;
+    }
+    if (stop != m->depot || visited + 1 != m->num_stops) {
+        fprintf(stderr, "%s: the legs must make one loop through all the stops\n", path);
+        return 0;
+    }
+    for (stop = 1; stop <= m->num_stops; stop++)
+        if (m->arrival_rate[stop] > 0.0 && m->num_destinations[stop] == 0) {
+            fprintf(stderr, "%s: people arrive at stop %d but have nowhere to go\n", path, stop);
+            return 0;
+        }
+    return 1;
+}
+
+void start(struct model *m) /* Initialize the current simlib context and schedule the first events of the model. */
+{
+    int stop, bus, i, j;
+    double lap_time;
 
     /* Initialize simlib */
 
     init_simlib();
 
+    /* The location queues are only ever filed LAST and removed FIRST, so keep them as FIFO lists. */
+
+    for (stop = 1; stop <= m->num_stops; stop++)
+        list_fifo(stop);
+
+    /* Estimate the percentiles to be reported. */
+
+    for (i = 0; i < 3 * m->num_stops; i++)
+        for (j = 0; j < num_percentiles; j++)
+            sampst_track(percentile_var(m, i), percentiles[j] / 100.0);
+
+    /* Watch the queue lengths and delays for the end of the warm-up. */
+
+    if (detect_warmup)
+        for (stop = 1; stop <= m->num_stops; stop++)
+            if (m->arrival_rate[stop] > 0.0) { // A stop nobody arrives at has no transient to leave.
+                warmup_filest(stop);
+                warmup_sampst(SVAR_DELAY(m, stop));
+            }
+
     /* Set maxatr = max(maximum number of attributes per record, 4) */
 
     maxatr = 4; /* NEVER SET maxatr TO BE SMALLER THAN 4. */
 
-    /* Schedule arrival of the bus to the car rental. */
+    /* Build the alias tables of the destinations. */
 
-    event_schedule(0.0, EVENT_BUS_ARRIVAL);
+    for (stop = 1; stop <= m->num_stops; stop++)
+        if (m->num_destinations[stop] > 0)
+            alias_setup(&m->destination_table[stop], m->destination_probability[stop], m->num_destinations[stop]);
 
-    /* Schedule arrival of the first person to the car rental and terminals. */
-    double test_interval = expon(1.0 / rental_arrival_rate, STREAM_INTERARRIVAL_RENTAL);
-    event_schedule(expon(1.0 / rental_arrival_rate, STREAM_INTERARRIVAL_RENTAL), EVENT_PERSON_ARRIVAL_RENTAL);
-    event_schedule(expon(1.0 / terminal_1_arrival_rate, STREAM_INTERARRIVAL_TERMINAL_1), EVENT_PERSON_ARRIVAL_TERMINAL_1);
-    event_schedule(expon(1.0 / terminal_2_arrival_rate, STREAM_INTERARRIVAL_TERMINAL_2), EVENT_PERSON_ARRIVAL_TERMINAL_2);
+    /* Put the buses empty at the depot, arriving one after the other, evenly spaced over the driving time of a lap. */
+
+    lap_time = 0.0;
+    for (stop = 1; stop <= m->num_stops; stop++) {
+        m->docked[stop] = NO_BUS;
+        m->claimed[stop] = 0;
+        lap_time += m->distance[stop];
+    }
+    lap_time /= m->bus_speed;
+    m->total_riders = 0;
+    for (bus = 0; bus < m->num_buses; bus++) {
+        m->bus_location[bus] = m->depot;
+        m->bus_arrived[bus] = 0;
+        m->bus_unloading[bus] = 0;
+        m->bus_loading[bus] = 0;
+        m->bus_arrive_time[bus] = 0.0;
+        m->bus_at_depot[bus] = 0.0;
+        m->bus_departure[bus] = 0;
+        m->riders[bus] = 0;
+        memset(m->compartment_head[bus], NO_SEAT, sizeof m->compartment_head[bus]);
+        for (i = 0; i < MAX_SEATS; i++)
+            m->seat_next[bus][i] = (signed char)(i + 1 < MAX_SEATS ? i + 1 : NO_SEAT);
+        m->free_seat[bus] = 0;
+        m->num_steps[bus] = m->steps_done[bus] = m->seats_left[bus] = 0;
+    }
+    m->num_planning = 0;
+
+    /* Schedule arrival of the buses to the depot. */
+
+    for (bus = 0; bus < m->num_buses; bus++)
+        bus_schedule(m, bus * lap_time / m->num_buses, EVENT_BUS_ARRIVAL, bus);
+
+    /* Skip one number of the interarrival stream of stop 1, which the original model drew and never used, so that every stream stays where
+       it was and the results stay the same.  It goes through expon, as then, so it comes from the generator picked with -g. */
+
+    (void)expon(1.0, STREAM_INTERARRIVAL(1));
+
+    /* Schedule arrival of the first person to every stop people arrive at.  With lazy_arrivals, only note its time: no bus is at a stop yet. */
+    m->next_arrival[0] = INFINITY;
+    for (stop = 1; stop <= m->num_stops; stop++) {
+        m->next_arrival[stop] = INFINITY;
+        if (m->arrival_rate[stop] > 0.0 && m->lazy_arrivals)
+            m->next_arrival[stop] = expon(1.0 / (m->arrival_rate[stop] * m->arrival_scale), STREAM_INTERARRIVAL(stop));
+        else if (m->arrival_rate[stop] > 0.0) {
+            transfer[EVENT_STOP] = stop;
+            transfer[EVENT_LOCATION] = stop;
+            event_schedule(expon(1.0 / (m->arrival_rate[stop] * m->arrival_scale), STREAM_INTERARRIVAL(stop)), EVENT_PERSON_ARRIVAL);
+        }
+    }
 
     /* Schedule the end of the simulation.  (This is needed for consistency of
        units.) */
 
-    event_schedule(length_simulation, EVENT_END_SIMULATION);
+    event_schedule(m->length_simulation, EVENT_END_SIMULATION);
+}
 
+int run(struct model *m, double until) /* Run the model until the end of the simulation, or until the first event at or after time "until" is done. */
+{
     /* Run the simulation until it terminates after an end-simulation event
-       (type EVENT_END_SIMULATION) occurs. */
+       (type EVENT_END_SIMULATION) occurs, or the clock reaches "until".  Return whether it terminated. */
 
     do {
 
@@ -287,56 +869,882 @@ int main() /* Main function. */
 
         timing();
 
+        /* Carry out the steps the buses planned up to this event (with aggregate_dwell). */
+
+        if (m->num_planning > 0)
+            do_steps(m);
+
         /* Invoke the appropriate event function. */
-        // print lists and states for debugging, delete later
-        // printf("------------------------------------------------------------\n");
-        // printf("Time: %f, Next event type: %d\n", sim_time, next_event_type);
-        // printf("Queue Lengths: Rental - %d, Terminal 1 - %d, Terminal 2 - %d, Bus - %d\n", list_size[RENTAL_ID], list_size[TERMINAL_1_ID], list_size[TERMINAL_2_ID], list_size[BUS_ID]);
-        // printf("Bus location: %d\n", current_bus_location);
-        // printf("Bus arrived: %d\n", bus_arrived);
-        // printf("Last bus arrive time: %f\n", last_bus_arrive_time);
+        // To see the events handled here, build with -DSIMLIB_TRACE, run with -L and read the trace with traceread.
 
         switch (next_event_type) {
-        case EVENT_PERSON_ARRIVAL_RENTAL:
-            // printf("Person arrival at rental\n"); // Debugging delete later
-            person_arrive(RENTAL_ID);
-            break;
-        case EVENT_PERSON_ARRIVAL_TERMINAL_1:
-            // printf("Person arrival at terminal 1\n"); // Debugging delete later
-            person_arrive(TERMINAL_1_ID);
-            break;
-        case EVENT_PERSON_ARRIVAL_TERMINAL_2:
-            // printf("Person arrival at terminal 2\n"); // Debugging delete later
-            person_arrive(TERMINAL_2_ID);
+        case EVENT_PERSON_ARRIVAL:
+            person_arrive(m, (int)transfer[EVENT_STOP]);
             break;
         case EVENT_BUS_ARRIVAL:
-            // printf("Bus arrival at location %d\n", current_bus_location); // Debugging delete later
-            bus_arrive(current_bus_location);
+            bus_arrive(m, (int)transfer[EVENT_BUS]);
             break;
         case EVENT_BUS_DEPARTURE:
-            // printf("Bus departure from location %d\n", current_bus_location); // Debugging delete later
-            bus_depart(current_bus_location);
+            bus_depart(m, (int)transfer[EVENT_BUS]);
             break;
         case EVENT_UNLOAD_PERSON:
-            // printf("Person unloading at location %d\n", current_bus_location); // Debugging delete later
-            person_unload(current_bus_location);
+            person_unload(m, (int)transfer[EVENT_BUS]);
             break;
         case EVENT_LOAD_PERSON:
-            // printf("Person loading at location %d\n", current_bus_location); // Debugging delete later
-            person_load(current_bus_location);
-            break;
-        case EVENT_END_SIMULATION:
-            report();
+            person_load(m, (int)transfer[EVENT_BUS]);
             break;
         }
 
         /* If the event just executed was not the end-simulation event (type
            EVENT_END_SIMULATION), continue simulating.  Otherwise, end the
-           simulation. */
+           simulation, leaving the statistics in the simlib context for the
+           caller to report. */
+
+    } while (next_event_type != EVENT_END_SIMULATION && sim_time < until);
+
+    /* With lazy_arrivals, put the people who arrived at stops without a bus in their queues, for the statistics or the checkpoint. */
+
+    if (m->lazy_arrivals)
+        arrivals_until(m, sim_time);
+    return next_event_type == EVENT_END_SIMULATION;
+}
+
+void simulate(struct model *m) /* Run the model in the current simlib context until the end of the simulation. */
+{
+    start(m);
+    run(m, INFINITY);
+}
+
+/* Number and names of the statistics gathered by collect(), in the order report() prints them, set by name_stats() for the route network. */
+int num_stats;
+char stat_names[MAX_STATS][64];
+
+void name_stats(const struct model *m) /* Name the statistics of the stops of "m". */
+{
+    const char *queue[2] = {"Average queue length", "Maximum queue length"};
+    const char *delay[2] = {"Average delay", "Maximum delay"};
+    const char *times[3] = {"Average", "Maximum", "Minimum"};
+    char stop[STOP_NAME];
+    int i = 0, j, k;
+    for (j = 1; j <= m->num_stops; j++)
+        for (k = 0, stop_label(m, j, stop); k < 2; k++)
+            snprintf(stat_names[i++], sizeof stat_names[0], "%s, %s", queue[k], stop);
+    for (j = 1; j <= m->num_stops; j++)
+        for (k = 0, stop_label(m, j, stop); k < 2; k++)
+            snprintf(stat_names[i++], sizeof stat_names[0], "%s, %s", delay[k], stop);
+    strcpy(stat_names[i++], "Average number of people on bus");
+    strcpy(stat_names[i++], "Maximum number of people on bus");
+    for (j = 1; j <= m->num_stops; j++)
+        for (k = 0, stop_label(m, j, stop); k < 3; k++)
+            snprintf(stat_names[i++], sizeof stat_names[0], "%s bus stop time, %s", times[k], stop);
+    for (k = 0; k < 3; k++)
+        snprintf(stat_names[i++], sizeof stat_names[0], "%s bus lap time", times[k]);
+    for (j = 1; j <= m->num_stops; j++)
+        for (k = 0, stop_label(m, j, stop); k < 3; k++)
+            snprintf(stat_names[i++], sizeof stat_names[0], "%s time in system, %s", times[k], stop);
+    num_stats = i;
+}
+
+int stat_group_start(const struct model *m, int i) /* Return whether statistic i is the first of a group that report() prints apart, other than the first. */
+{
+    int s = m->num_stops;
+    return i == 2 * s || i == 4 * s || i == 4 * s + 2 || i == 7 * s + 2 || i == 7 * s + 5;
+}
+
+void collect(const struct model *m, double stats[]) /* Gather the statistics printed by report() from the current simlib context. */
+{
+    int i = 0, stop;
+    for (stop = 1; stop <= m->num_stops; stop++) { // Queue length.
+        filest(stop);
+        stats[i++] = transfer[1];
+        stats[i++] = transfer[2];
+    }
+    for (stop = 1; stop <= m->num_stops; stop++) { // Delay.
+        sampst(0.0, -SVAR_DELAY(m, stop));
+        stats[i++] = transfer[1];
+        stats[i++] = transfer[3];
+    }
+    filest(BUS_LIST(m));
+    stats[i++] = transfer[1];
+    stats[i++] = transfer[2];
+    for (stop = 1; stop <= m->num_stops; stop++) { // Bus stop time.
+        sampst(0.0, -SVAR_STOP_TIME(m, stop));
+        stats[i++] = transfer[1];
+        stats[i++] = transfer[3];
+        stats[i++] = transfer[4];
+    }
+    sampst(0.0, -SVAR_LAP(m));
+    stats[i++] = transfer[1];
+    stats[i++] = transfer[3];
+    stats[i++] = transfer[4];
+    for (stop = 1; stop <= m->num_stops; stop++) { // Time in system.
+        sampst(0.0, -SVAR_TIME_IN_SYSTEM(m, stop));
+        stats[i++] = transfer[1];
+        stats[i++] = transfer[3];
+        stats[i++] = transfer[4];
+    }
+}
+
+void print_precision(const char *name) /* Print the average, CI half-width and number of batches left in transfer by sampst_ci or filest_ci. */
+{
+    fprintf(outfile, "\n%-36s%15.3f%23.3f%12d", name, transfer[1], transfer[2], (int)transfer[4]);
+}
+
+void report_precision(const struct model *m) /* Report the 95% confidence interval half-width of every average printed by report(), from batch means within the run. */
+{
+    int i = 0, stop;
+    fprintf(outfile, "\n\n\n\n%-36s%15s%23s%12s\n", "Statistic", "Average", "95% CI half-width", "Batches");
+    for (stop = 1; stop <= m->num_stops; stop++, i += 2) { // Queue length.
+        filest_ci(stop);
+        print_precision(stat_names[i]);
+    }
+    fprintf(outfile, "\n");
+    for (stop = 1; stop <= m->num_stops; stop++, i += 2) { // Delay.
+        sampst_ci(SVAR_DELAY(m, stop));
+        print_precision(stat_names[i]);
+    }
+    fprintf(outfile, "\n");
+    filest_ci(BUS_LIST(m));
+    print_precision(stat_names[i]);
+    i += 2;
+    fprintf(outfile, "\n");
+    for (stop = 1; stop <= m->num_stops; stop++, i += 3) { // Bus stop time.
+        sampst_ci(SVAR_STOP_TIME(m, stop));
+        print_precision(stat_names[i]);
+    }
+    fprintf(outfile, "\n");
+    sampst_ci(SVAR_LAP(m));
+    print_precision(stat_names[i]);
+    i += 3;
+    fprintf(outfile, "\n");
+    for (stop = 1; stop <= m->num_stops; stop++, i += 3) { // Time in system.
+        sampst_ci(SVAR_TIME_IN_SYSTEM(m, stop));
+        print_precision(stat_names[i]);
+    }
+}
+
+/* Shared state of a set of replications run on a pool of threads. Each thread takes the next replication number under the lock and runs it in its
+   own simlib context; the results go to disjoint rows of stats. When an alternative scenario is given, every replication runs it too, on the same
+   seeds: each source of randomness in the model has its own stream, so both scenarios see the same arrivals, destinations and (as far as the
+   bus serves people in the same order) load and unload times, and the paired differences have a far smaller variance than independent runs. */
+struct replications {
+    int count;                       // Number of replications.
+    int next;                        // Next replication to run.
+    int generator;                   // RNG_LCGRAND or RNG_MRG32K3A.
+    int antithetic;                  // Whether replications 2k and 2k + 1 are an antithetic pair on the seeds of replication k.
+    const struct model *model;       // Parameters and initial state of every replication.
+    const struct model *alternative; // Scenario compared with model on common random numbers, or NULL.
+    const char *restore_file;        // Checkpoint every replication starts from instead, or NULL.
+    double (*stats)[MAX_STATS];      // Statistics of each replication.
+    double (*alt_stats)[MAX_STATS];  // Statistics of each replication of the alternative scenario.
+    double *warmup_end;              // Time each replication reset its statistics at, or -1.
+    pthread_mutex_t lock;
+};
+
+int num_streams(const struct model *m) /* Return the number of random-number streams used by model "m": streams 1 to 6, and one more for every stop after the third. */
+{
+    return m->num_stops <= 3 ? 6 : m->num_stops + 3;
+}
+
+void seed_replication(const struct model *m, int replication, int generator) /* Give replication number "replication" (from 0) its own seed set for the streams of model "m". */
+{
+    // With lcgrand, replication r uses virtual streams n * r + 1 through n * (r + 1), for the n streams of the model, so replication 0 uses the
+    // default seeds. With MRG32k3a, replication r uses substream r of each model stream, so there is no limit on the number of replications.
+    int stream, n = num_streams(m);
+    rng_select(generator);
+    for (stream = 1; stream <= n; stream++) {
+        if (generator == RNG_MRG32K3A)
+            mrgrandss(replication, stream);
+        else
+            lcgrandvs((long)n * replication + stream, stream);
+    }
+}
+
+void *replicate(void *arg) /* Thread function running replications until none are left. */
+{
+    struct replications *reps = arg;
+    struct sim_ctx *ctx = sim_ctx_new();
+    struct model model;
+    int replication, seeds;
+
+    sim_ctx_bind(ctx);
+    event_backend(event_list);
+    for (;;) {
+        pthread_mutex_lock(&reps->lock);
+        replication = reps->next++;
+        pthread_mutex_unlock(&reps->lock);
+        if (replication >= reps->count)
+            break;
+        seeds = reps->antithetic ? replication / 2 : replication;
+        if (reps->restore_file != NULL) {
+            // Branch off the checkpointed state with the seeds of this replication.
+            if (!restore(reps->restore_file, &model, sizeof model)) {
+                fprintf(stderr, "cannot restore %s\n", reps->restore_file);
+                exit(1);
+            }
+            seed_replication(reps->model, seeds, reps->generator);
+            rng_antithetic(reps->antithetic && replication % 2 == 1);
+            run(&model, INFINITY);
+        } else {
+            model = *reps->model;
+            seed_replication(reps->model, seeds, reps->generator);
+            rng_antithetic(reps->antithetic && replication % 2 == 1);
+            simulate(&model);
+        }
+        collect(&model, reps->stats[replication]);
+        reps->warmup_end[replication] = warmup_end();
+        if (reps->alternative != NULL) {
+            model = *reps->alternative;
+            seed_replication(reps->model, seeds, reps->generator);
+            rng_antithetic(reps->antithetic && replication % 2 == 1);
+            simulate(&model);
+            collect(&model, reps->alt_stats[replication]);
+        }
+    }
+    sim_ctx_delete(ctx);
+    return NULL;
+}
+
+int observations(const struct replications *reps, double (*stats)[MAX_STATS], double (*minus)[MAX_STATS], int i, double obs[]) /* Place the independent observations of statistic i in obs, less the same statistic in "minus" if it is not NULL, and return their number: one per replication, or the average of each antithetic pair. */
+{
+    int r, n = 0;
+    for (r = 0; r < reps->count; r++) {
+        double x = stats[r][i] - (minus != NULL ? minus[r][i] : 0.0);
+        if (reps->antithetic && r % 2 == 1)
+            obs[n - 1] = 0.5 * (obs[n - 1] + x);
+        else
+            obs[n++] = x;
+    }
+    return n;
+}
+
+void summarize(const double obs[], int n, double *mean, double *var) /* Compute the mean and sample variance of n observations. */
+{
+    int r;
+    *mean = 0.0;
+    for (r = 0; r < n; r++)
+        *mean += obs[r];
+    *mean /= n;
+    *var = 0.0;
+    for (r = 0; r < n; r++)
+        *var += (obs[r] - *mean) * (obs[r] - *mean);
+    *var = (n > 1) ? *var / (n - 1) : 0.0;
+}
+
+void report_comparison(struct replications *reps) /* Report both scenarios and the mean and 95% confidence interval of their paired difference for every statistic. */
+{
+    double *obs = malloc(reps->count * sizeof *obs), mean, alt_mean, diff, var, alt_var, diff_var, t;
+    int i, n = 0;
+
+    fprintf(outfile, "\n%-36s%15s%15s%15s%19s%19s\n", "Statistic", "Base mean", "Alt. mean", "Difference", "Paired half-width",
+            "Indep. half-width");
+    for (i = 0; i < num_stats; i++) {
+        if (stat_group_start(reps->model, i))
+            fprintf(outfile, "\n");
+        n = observations(reps, reps->stats, NULL, i, obs);
+        summarize(obs, n, &mean, &var);
+        observations(reps, reps->alt_stats, NULL, i, obs);
+        summarize(obs, n, &alt_mean, &alt_var);
+        observations(reps, reps->alt_stats, reps->stats, i, obs);
+        summarize(obs, n, &diff, &diff_var);
+        // The independent half-width is what the same number of independent runs of each scenario would give, for comparison.
+        t = (n > 1) ? student_t95(n - 1) : 0.0;
+        fprintf(outfile, "\n%-36s%15.3f%15.3f%15.3f%19.3f%19.3f", stat_names[i], mean, alt_mean, diff, t * sqrt(diff_var / n),
+                t * sqrt((var + alt_var) / n));
+    }
+    fprintf(outfile, "\n");
+    free(obs);
+}
+
+void report_replications(struct replications *reps) /* Report mean, standard deviation and 95% confidence interval of every statistic across replications. */
+{
+    int i, r, n = reps->count;
+    double mean, var, half_width, *obs;
+
+    if (reps->antithetic)
+        fprintf(outfile, "%d replications in %d antithetic pairs\n\n", n, n / 2);
+    else
+        fprintf(outfile, "%d independent replications\n\n", n);
+    if (reps->alternative != NULL)
+        fprintf(outfile, "Each replication runs both scenarios on common random numbers\n\n");
+    if (detect_warmup) {
+        // Average the reset times over the replications that found the end of the warm-up.
+        int detected = 0;
+        mean = 0.0;
+        for (r = 0; r < n; r++)
+            if (reps->warmup_end[r] >= 0.0) {
+                mean += reps->warmup_end[r];
+                detected++;
+            }
+        fprintf(outfile, "Warm-up detected in %d replications, statistics reset at %.3f hours on average\n\n", detected,
+                detected > 0 ? mean / detected / 60.0 / 60.0 : 0.0);
+    }
+    if (reps->alternative != NULL) {
+        report_comparison(reps);
+        return;
+    }
+    obs = malloc(n * sizeof *obs);
+    fprintf(outfile, "\nStatistic                                       Mean          Std dev      95%% CI half-width\n");
+    for (i = 0; i < num_stats; i++) {
+        if (stat_group_start(reps->model, i))
+            fprintf(outfile, "\n");
+        n = observations(reps, reps->stats, NULL, i, obs);
+        summarize(obs, n, &mean, &var);
+        half_width = (n > 1) ? student_t95(n - 1) * sqrt(var / n) : 0.0;
+        fprintf(outfile, "\n%-36s%15.3f%17.3f%23.3f", stat_names[i], mean, sqrt(var), half_width);
+    }
+    fprintf(outfile, "\n");
+    free(obs);
+}
+
+void run_replications(struct replications *reps, int num_threads) /* Run the replications set up in "reps" (count, generator, antithetic, model, alternative and restore_file) on "num_threads" threads and report them. */
+{
+    pthread_t *threads;
+    int i;
+
+    reps->next = 0;
+    reps->stats = malloc(reps->count * sizeof *reps->stats);
+    reps->alt_stats = (reps->alternative != NULL) ? malloc(reps->count * sizeof *reps->alt_stats) : NULL;
+    reps->warmup_end = malloc(reps->count * sizeof *reps->warmup_end);
+    pthread_mutex_init(&reps->lock, NULL);
+    threads = malloc(num_threads * sizeof *threads);
+    for (i = 0; i < num_threads; i++)
+        pthread_create(&threads[i], NULL, replicate, reps);
+    for (i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+    report_replications(reps);
+    pthread_mutex_destroy(&reps->lock);
+    free(threads);
+    free(reps->stats);
+    free(reps->alt_stats);
+    free(reps->warmup_end);
+}
+
+/* A parameter sweep: every scenario (a list of parameter settings, crossed with a grid) is run for a number of replications. The (scenario,
+   replication) jobs go to a pool of threads like the replications above, and each finished job is appended to a CSV file as one row, flushed at
+   once, so an interrupted sweep keeps every job it finished. Run again with the same options, it skips the jobs already in the file. Replication
+   r has the same seeds in every scenario, so the scenarios are compared on common random numbers. A row only counts as done if its scenario
+   label and every parameter value match, so a sweep rerun with other base settings (-s, -T) runs again. */
+struct scenario {
+    struct model model;
+    char label[SCENARIO_LABEL]; // The settings that make this scenario, as name=value;name=value, or "base".
+    char *key;                  // The label and the values of all parameters, as they start each CSV row of this scenario.
+};
+
+struct sweep {
+    struct scenario *scenarios;
+    int num_scenarios;
+    int count;      // Replications per scenario.
+    int generator;  // RNG_LCGRAND or RNG_MRG32K3A.
+    long next;      // Next job to run; job j is replication j % count of scenario j / count.
+    char *done;     // Whether each job is in the file already.
+    long num_done;  // Number of jobs in the file.
+    FILE *csvfile;
+    pthread_mutex_t lock;
+};
+
+int add_setting(struct scenario *s, const char *assignment) /* Apply "name=value" to scenario "s" and add it to its label; return 0 if it is not a valid setting. */
+{
+    size_t used = strcmp(s->label, "base") == 0 ? 0 : strlen(s->label);
+    if (!set_parameter(&s->model, assignment) || used + strlen(assignment) + 2 > SCENARIO_LABEL)
+        return 0;
+    if (used > 0)
+        s->label[used++] = ';';
+    strcpy(s->label + used, assignment);
+    return 1;
+}
+
+int read_scenarios(struct sweep *sw, const struct model *base, const char *path) /* Start the sweep with one scenario per line of file "path" (name=value settings separated by blanks, # for comments), or with "base" alone if path is NULL. Return 0 on a bad file. */
+{
+    char line[1024], *token;
+    FILE *file;
+
+    sw->num_scenarios = 0;
+    sw->scenarios = malloc(sizeof *sw->scenarios);
+    if (path == NULL) {
+        sw->scenarios[0].model = *base;
+        strcpy(sw->scenarios[0].label, "base");
+        sw->num_scenarios = 1;
+        return 1;
+    }
+    file = fopen(path, "r");
+    if (file == NULL)
+        return 0;
+    while (fgets(line, sizeof line, file) != NULL) {
+        if (strchr(line, '#') != NULL)
+            *strchr(line, '#') = '\0';
+        token = strtok(line, " \t\r\n");
+        if (token == NULL)
+            continue;
+        sw->scenarios = realloc(sw->scenarios, (sw->num_scenarios + 1) * sizeof *sw->scenarios);
+        sw->scenarios[sw->num_scenarios].model = *base;
+        strcpy(sw->scenarios[sw->num_scenarios].label, "base");
+        for (; token != NULL; token = strtok(NULL, " \t\r\n"))
+            if (!add_setting(&sw->scenarios[sw->num_scenarios], token)) {
+                fclose(file);
+                return 0;
+            }
+        sw->num_scenarios++;
+    }
+    fclose(file);
+    return sw->num_scenarios > 0;
+}
+
+int cross_scenarios(struct sweep *sw, const char *axis) /* Cross the scenarios with grid axis "name=v1,v2,...", giving each of them every value in turn. Return 0 on a bad axis. */
+{
+    const char *values = strchr(axis, '='), *value;
+    struct scenario *crossed;
+    char setting[256];
+    int num_values = 1, s, n = 0;
+    size_t length;
+
+    if (values == NULL || (size_t)(values - axis) + 1 >= sizeof setting)
+        return 0;
+    for (value = values + 1; *value != '\0'; value++)
+        num_values += (*value == ',');
+    crossed = malloc((long)sw->num_scenarios * num_values * sizeof *crossed);
+    for (s = 0; s < sw->num_scenarios; s++)
+        for (value = values + 1;; value += length + 1) {
+            length = strcspn(value, ",");
+            if ((size_t)(values - axis) + 1 + length >= sizeof setting) {
+                free(crossed);
+                return 0;
+            }
+            snprintf(setting, sizeof setting, "%.*s=%.*s", (int)(values - axis), axis, (int)length, value);
+            crossed[n] = sw->scenarios[s];
+            if (!add_setting(&crossed[n++], setting)) {
+                free(crossed);
+                return 0;
+            }
+            if (value[length] == '\0')
+                break;
+        }
+    free(sw->scenarios);
+    sw->scenarios = crossed;
+    sw->num_scenarios = n;
+    return 1;
+}
+
+void csv_header(char *header, size_t size) /* Write the header row of the sweep CSV file into "header": the scenario, the parameters, the replication and the statistics. */
+{
+    size_t used;
+    const char *c;
+    int i;
+
+    used = snprintf(header, size, "scenario");
+    for (i = 0; i < NUM_PARAMETERS; i++)
+        used += snprintf(header + used, size - used, ",%s", parameters[i].name);
+    used += snprintf(header + used, size - used, ",replication");
+    for (i = 0; i < num_stats; i++) {
+        // The statistic names in snake case: "Average delay, rental" becomes average_delay_rental.
+        header[used++] = ',';
+        for (c = stat_names[i]; *c != '\0'; c++)
+            if (*c != ',')
+                header[used++] = (*c == ' ') ? '_' : (char)tolower((unsigned char)*c);
+    }
+    snprintf(header + used, size - used, "\n");
+}
 
-    } while (next_event_type != EVENT_END_SIMULATION);
+char *scenario_key(const struct scenario *s) /* Return the start of the CSV rows of scenario "s", in a new string: its label and the values of the parameters in command-line units. */
+{
+    char key[CSV_LINE];
+    size_t used;
+    int i;
+
+    used = snprintf(key, sizeof key, "%s", s->label);
+    for (i = 0; i < NUM_PARAMETERS; i++)
+        used += snprintf(key + used, sizeof key - used, ",%.10g", parameters[i].is_int ? *(int *)((char *)&s->model + parameters[i].offset)
+                                                                   : *(double *)((char *)&s->model + parameters[i].offset) / parameters[i].scale);
+    return strdup(key);
+}
+
+int resume_sweep(struct sweep *sw, const char *path, const char *header) /* Mark the jobs already in CSV file "path" as done, drop any row cut short by an interruption, and open the file for appending. Return 0 if the file belongs to another sweep or cannot be opened. */
+{
+    char line[CSV_LINE], *comma, *replication_field = NULL;
+    long kept = 0, job;
+    int s, replication, fields;
+    FILE *file = fopen(path, "r");
+
+    sw->num_done = 0;
+    if (file != NULL) {
+        if (fgets(line, sizeof line, file) == NULL || strcmp(line, header) != 0) {
+            fclose(file);
+            return 0;
+        }
+        kept = ftell(file);
+        while (fgets(line, sizeof line, file) != NULL && strchr(line, '\n') != NULL) {
+            // Split the row after the parameters, where the replication number starts.
+            for (fields = 1, comma = line; (comma = strchr(comma, ',')) != NULL; comma++)
+                if (fields++ == 1 + NUM_PARAMETERS)
+                    replication_field = comma;
+            if (fields != 2 + NUM_PARAMETERS + num_stats || sscanf(replication_field + 1, "%d", &replication) != 1)
+                break;
+            *replication_field = '\0';
+            for (s = 0; s < sw->num_scenarios && strcmp(sw->scenarios[s].key, line) != 0; s++)
+                ;
+            if (s < sw->num_scenarios && replication >= 0 && replication < sw->count) {
+                job = (long)s * sw->count + replication;
+                sw->num_done += !sw->done[job];
+                sw->done[job] = 1;
+            }
+            kept = ftell(file);
+        }
+        fclose(file);
+        if (truncate(path, kept) != 0)
+            return 0;
+    }
+    sw->csvfile = fopen(path, "a");
+    if (sw->csvfile == NULL)
+        return 0;
+    if (kept == 0)
+        fputs(header, sw->csvfile);
+    return 1;
+}
+
+void *sweep_worker(void *arg) /* Thread function running sweep jobs until none are left. */
+{
+    struct sweep *sw = arg;
+    struct sim_ctx *ctx = sim_ctx_new();
+    struct model model;
+    double stats[MAX_STATS];
+    long job;
+    int s, replication, i;
+
+    sim_ctx_bind(ctx);
+    event_backend(event_list);
+    for (;;) {
+        pthread_mutex_lock(&sw->lock);
+        while (sw->next < (long)sw->num_scenarios * sw->count && sw->done[sw->next])
+            sw->next++;
+        job = sw->next++;
+        pthread_mutex_unlock(&sw->lock);
+        if (job >= (long)sw->num_scenarios * sw->count)
+            break;
+        s = job / sw->count;
+        replication = job % sw->count;
+        model = sw->scenarios[s].model;
+        seed_replication(&model, replication, sw->generator);
+        rng_antithetic(0);
+        simulate(&model);
+        collect(&model, stats);
+
+        // Append the row in one go and flush it, so that the file only ever ends in a complete row or in part of the row being written.
+        pthread_mutex_lock(&sw->lock);
+        fprintf(sw->csvfile, "%s,%d", sw->scenarios[s].key, replication);
+        for (i = 0; i < num_stats; i++)
+            fprintf(sw->csvfile, ",%.10g", stats[i]);
+        fprintf(sw->csvfile, "\n");
+        fflush(sw->csvfile);
+        sw->done[job] = 1;
+        sw->num_done++;
+        pthread_mutex_unlock(&sw->lock);
+    }
+    sim_ctx_delete(ctx);
+    return NULL;
+}
+
+int run_sweep(struct sweep *sw, const char *path, int num_threads) /* Run the jobs of sweep "sw" not yet in CSV file "path" on "num_threads" threads, appending their rows to it. Return 0 if the file cannot be used. */
+{
+    char header[CSV_LINE];
+    pthread_t *threads;
+    long resumed, total = (long)sw->num_scenarios * sw->count;
+    int i;
+
+    csv_header(header, sizeof header);
+    for (i = 0; i < sw->num_scenarios; i++)
+        sw->scenarios[i].key = scenario_key(&sw->scenarios[i]);
+    sw->next = 0;
+    sw->done = calloc(total, 1);
+    if (!resume_sweep(sw, path, header)) {
+        free(sw->done);
+        return 0;
+    }
+    resumed = sw->num_done;
+    if (num_threads > total - resumed)
+        num_threads = (total - resumed > 0) ? (int)(total - resumed) : 1;
+    pthread_mutex_init(&sw->lock, NULL);
+    threads = malloc(num_threads * sizeof *threads);
+    for (i = 0; i < num_threads; i++)
+        pthread_create(&threads[i], NULL, sweep_worker, sw);
+    for (i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&sw->lock);
+    fclose(sw->csvfile);
+    printf("%d scenarios x %d replications: %ld jobs run, %ld already in %s\n", sw->num_scenarios, sw->count, total - resumed, resumed, path);
+    for (i = 0; i < sw->num_scenarios; i++)
+        free(sw->scenarios[i].key);
+    free(threads);
+    free(sw->done);
+    return 1;
+}
+
+int default_threads(void) /* Number of threads to use when none is given: one per online processor. */
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0)
+        return (int)n;
+#endif
+    return 1;
+}
+
+int main(int argc, char *argv[]) /* Main function. */
+{
+    struct model model = model_default, alternative;
+    struct replications reps = {0};
+    struct sweep sweep = {0};
+    const char **changes = malloc(argc * sizeof *changes), **axes = malloc(argc * sizeof *axes);
+    int replications = 0, num_threads = default_threads(), generator = RNG_LCGRAND, branch = 0, num_changes = 0, antithetic = 0, num_axes = 0, i;
+    double hours = 0.0, warmup_hours = 0.0;
+    const char *checkpoint_file = NULL, *restore_file = NULL, *scenario_file = NULL, *csv_file = "sweep.csv", *trace_file = NULL;
+
+    /* Read the options: -r R runs R independent replications and reports them together, -t T runs them on T threads, -g G draws them from
+       generator G (lcgrand or mrg32k3a), -T H simulates H hours instead of 80 (a single run then also reports the 95% CI half-widths of its
+       averages from batch means), -p P1,P2,... reports percentiles P1, P2, ... (up to MAX_QUANT) of delay, bus stop time and time in system,
+       -W resets the statistics once queue lengths and delays leave their initial transient.  -c F -w H
+       runs the first H hours, saves the state to checkpoint file F and stops; -R F resumes from checkpoint F (the same run bit for bit, or with
+       -b B the branch with the seeds of replication B, or with -r R R such branches).  -s NAME=VALUE sets a parameter (see parameters[]);
+       -d NAME=VALUE changes it in an alternative scenario, which the R replications then also run on common random numbers, reporting the paired
+       differences; -A runs the replications as antithetic pairs.  -X F sweeps the scenarios listed in file F, -x NAME=V1,V2,... crosses them
+       (or the base scenario) with the values given, and each of the R replications (1 by default) of every scenario becomes a row of CSV file
+       -o F (sweep.csv by default).  -N F replaces the route network with the one in file F (see load_network()), before the -s that follow.  -L F records every event of a
+       single run, with the lengths of the location queues and of the bus list, to trace file F (simlib must be compiled with -DSIMLIB_TRACE;
+       traceread prints the file).  -E B keeps the pending events in backend B of simlib (heap or calendar), which changes the speed but not the
+       results. */
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            replications = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            num_threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc)
+            hours = atof(argv[++i]);
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            char *p = argv[++i], *end;
+            for (num_percentiles = 0; *p != '\0'; p = (*end == ',') ? end + 1 : end) {
+                double percentile = strtod(p, &end);
+                if (end == p || percentile <= 0.0 || percentile >= 100.0 || num_percentiles == MAX_QUANT) {
+                    fprintf(stderr, "%s: need 1 to %d percentiles between 0 and 100, separated by commas\n", argv[0], MAX_QUANT);
+                    return 1;
+                }
+                percentiles[num_percentiles++] = percentile;
+            }
+        }
+        else if (strcmp(argv[i], "-W") == 0)
+            detect_warmup = 1;
+        else if (strcmp(argv[i], "-A") == 0)
+            antithetic = 1;
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            changes[num_changes++] = argv[++i];
+        else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc)
+            axes[num_axes++] = argv[++i];
+        else if (strcmp(argv[i], "-X") == 0 && i + 1 < argc)
+            scenario_file = argv[++i];
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            csv_file = argv[++i];
+        else if (strcmp(argv[i], "-L") == 0 && i + 1 < argc)
+            trace_file = argv[++i];
+        else if (strcmp(argv[i], "-N") == 0 && i + 1 < argc) {
+            if (!load_network(&model, argv[++i]))
+                return 1;
+        }
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            if (!set_parameter(&model, argv[++i])) {
+                fprintf(stderr, "%s: unknown parameter or bad value in %s\n", argv[0], argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+            warmup_hours = atof(argv[++i]);
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            checkpoint_file = argv[++i];
+        else if (strcmp(argv[i], "-R") == 0 && i + 1 < argc)
+            restore_file = argv[++i];
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+            branch = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            i++;
+            generator = strcmp(argv[i], "lcgrand") == 0 ? RNG_LCGRAND : strcmp(argv[i], "mrg32k3a") == 0 ? RNG_MRG32K3A : 0;
+        }
+        else if (strcmp(argv[i], "-E") == 0 && i + 1 < argc) {
+            i++;
+            event_list = strcmp(argv[i], "heap") == 0 ? EVLIST_HEAP : strcmp(argv[i], "calendar") == 0 ? EVLIST_CALENDAR : 0;
+        }
+        else {
+            fprintf(stderr, "usage: %s [-r replications] [-t threads] [-g lcgrand|mrg32k3a] [-E heap|calendar] [-T hours] [-p percentiles] [-W]\n"
+                            "       [-N network_file] [-s name=value]... [-d name=value]... [-A]\n"
+                            "       [-X scenario_file] [-x name=value,value...]... [-o csv_file]\n"
+                            "       [-c checkpoint_file -w warmup_hours | -R checkpoint_file [-b branch]] [-L trace_file]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!bounds_ordered(&model)) {
+        fprintf(stderr, "%s: a lower bound of the unload or load time is above the upper one\n", argv[0]);
+        return 1;
+    }
+    if (hours < 0.0 || warmup_hours < 0.0) {
+        fprintf(stderr, "%s: the simulated time cannot be negative\n", argv[0]);
+        return 1;
+    }
+    if ((checkpoint_file != NULL && restore_file != NULL) || branch < 0 || (generator == RNG_LCGRAND && (long)branch * num_streams(&model) > MAX_VSTREAM)) {
+        fprintf(stderr, "%s: cannot both save and restore a checkpoint, and the branch must be from 0 to %d\n", argv[0], MAX_VSTREAM / num_streams(&model));
+        return 1;
+    }
+    if (generator == 0 || event_list == 0) {
+        fprintf(stderr, "%s: generator must be lcgrand or mrg32k3a, and event list heap or calendar\n", argv[0]);
+        return 1;
+    }
+    event_backend(event_list);
+    // The end of the warm-up is looked for in the queue lengths as people arrive, which lazy_arrivals leaves until a bus comes.
+    if (detect_warmup && model.lazy_arrivals) {
+        fprintf(stderr, "%s: -W cannot be combined with lazy_arrivals\n", argv[0]);
+        return 1;
+    }
+    if (generator == RNG_LCGRAND && num_streams(&model) > MAX_STREAM) {
+        fprintf(stderr, "%s: %d stops need %d streams, more than the %d of lcgrand (use -g mrg32k3a)\n", argv[0], model.num_stops, num_streams(&model),
+                MAX_STREAM);
+        return 1;
+    }
+
+    /* Run the warm-up and save its final state. */
+
+    if (checkpoint_file != NULL) {
+        rng_select(generator);
+        start(&model);
+        if (run(&model, warmup_hours * 60.0 * 60.0) || !checkpoint(checkpoint_file, &model, sizeof model)) {
+            fprintf(stderr, "%s: cannot save a checkpoint to %s after %g hours\n", argv[0], checkpoint_file, warmup_hours);
+            return 1;
+        }
+        printf("State after %.3f hours saved to %s\n", sim_time / 60.0 / 60.0, checkpoint_file);
+        free_simlib();
+        return 0;
+    }
+    if (hours > 0.0)
+        model.length_simulation = hours * 60.0 * 60.0;
+    if (replications < 0 || (generator == RNG_LCGRAND && (long)replications * num_streams(&model) > MAX_VSTREAM) || num_threads < 1) {
+        fprintf(stderr, "%s: need 0 to %d replications and at least one thread\n", argv[0], MAX_VSTREAM / num_streams(&model));
+        return 1;
+    }
+    /* Run the sweep: every scenario for the replications asked for, or once. */
+
+    if (num_axes > 0 || scenario_file != NULL) {
+        if (num_changes > 0 || antithetic || restore_file != NULL || trace_file != NULL) {
+            fprintf(stderr, "%s: a sweep cannot be combined with -d, -A, -R or -L\n", argv[0]);
+            return 1;
+        }
+        sweep.count = (replications > 0) ? replications : 1;
+        sweep.generator = generator;
+        if (!read_scenarios(&sweep, &model, scenario_file)) {
+            fprintf(stderr, "%s: cannot read the scenarios in %s\n", argv[0], scenario_file);
+            return 1;
+        }
+        for (i = 0; i < num_axes; i++)
+            if (!cross_scenarios(&sweep, axes[i])) {
+                fprintf(stderr, "%s: bad sweep axis %s\n", argv[0], axes[i]);
+                return 1;
+            }
+        for (i = 0; i < sweep.num_scenarios; i++)
+            if (detect_warmup && sweep.scenarios[i].model.lazy_arrivals) {
+                fprintf(stderr, "%s: -W cannot be combined with lazy_arrivals (scenario %s)\n", argv[0], sweep.scenarios[i].label);
+                return 1;
+            } else if (!bounds_ordered(&sweep.scenarios[i].model)) {
+                fprintf(stderr, "%s: a lower bound of the unload or load time is above the upper one (scenario %s)\n", argv[0], sweep.scenarios[i].label);
+                return 1;
+            }
+        name_stats(&model);
+        if (!run_sweep(&sweep, csv_file, num_threads)) {
+            fprintf(stderr, "%s: cannot write %s, or it holds the results of another kind of sweep\n", argv[0], csv_file);
+            return 1;
+        }
+        free(sweep.scenarios);
+        free(changes);
+        free(axes);
+        return 0;
+    }
+    free(axes);
+    if (trace_file != NULL && replications > 0) {
+        fprintf(stderr, "%s: a trace records a single run, not replications\n", argv[0]);
+        return 1;
+    }
+    if ((num_changes > 0 || antithetic) && replications == 0) {
+        fprintf(stderr, "%s: scenario comparisons and antithetic pairs need replications (-r)\n", argv[0]);
+        return 1;
+    }
+    if ((num_changes > 0 && restore_file != NULL) || (antithetic && replications % 2 != 0)) {
+        fprintf(stderr, "%s: cannot compare scenarios from a checkpoint, and antithetic pairs need an even number of replications\n", argv[0]);
+        return 1;
+    }
+
+    /* Set up the alternative scenario: the base one with the changes given. */
+
+    alternative = model;
+    for (i = 0; i < num_changes; i++)
+        if (!set_parameter(&alternative, changes[i])) {
+            fprintf(stderr, "%s: unknown parameter or bad value in %s\n", argv[0], changes[i]);
+            return 1;
+        }
+    if (!bounds_ordered(&alternative)) {
+        fprintf(stderr, "%s: a lower bound of the unload or load time is above the upper one in the alternative scenario\n", argv[0]);
+        return 1;
+    }
+    free(changes);
+
+    /* A checkpoint brings its own model, route network included. */
+
+    if (restore_file != NULL && !restore(restore_file, &model, sizeof model)) {
+        fprintf(stderr, "%s: cannot restore %s\n", argv[0], restore_file);
+        return 1;
+    }
+    if (detect_warmup && (model.lazy_arrivals || alternative.lazy_arrivals)) {
+        fprintf(stderr, "%s: -W cannot be combined with lazy_arrivals\n", argv[0]);
+        return 1;
+    }
+    name_stats(&model);
+
+    /* Open output files. */
+
+    outfile = fopen("carrental.out", "w");
+
+    /* Write report heading and input parameters. */
+
+    fprintf(outfile, "Car Rental Air Terminals model\n\n");
+
+    /* Run the replications, or a single simulation in the default simlib context, and report. */
+
+    if (replications > 0) {
+        reps.count = replications;
+        reps.generator = generator;
+        reps.antithetic = antithetic;
+        reps.model = &model;
+        reps.alternative = (num_changes > 0) ? &alternative : NULL;
+        reps.restore_file = restore_file;
+        run_replications(&reps, num_threads < replications ? num_threads : replications);
+        fclose(outfile);
+        return 0;
+    }
+
+    if (trace_file != NULL && !trace_open(trace_file, 0, BUS_LIST(&model))) {
+        fprintf(stderr, "%s: cannot record a trace to %s (simlib must be compiled with -DSIMLIB_TRACE)\n", argv[0], trace_file);
+        return 1;
+    }
+    if (restore_file != NULL) {
+        if (branch > 0)
+            seed_replication(&model, branch, generator);
+        run(&model, INFINITY);
+    } else {
+        rng_select(generator);
+        simulate(&model);
+    }
+    trace_close();
+    if (detect_warmup)
+        report_warmup();
+    report(&model);
+    if (hours > 0.0) // A long run asked for with -T also reports its own precision.
+        report_precision(&model);
+    out_profile(outfile); // Writes nothing unless simlib is compiled with -DSIMLIB_PROFILE.
 
     fclose(outfile);
+    free_simlib();
 
     return 0;
 }
@@ -0,0 +1,329 @@
+/* Micro-benchmarks for the simlib primitives. */
+// Every benchmark runs in a fresh simlib context holding a given number of pending records (events on the event list, or records on list 1),
+// times a batch of operations with the monotonic clock and reports nanoseconds per operation and operations per second. The results go to stdout
+// as a table and to a CSV file (one row per benchmark and size, tagged with a label such as the commit) so runs can be compared across commits.
+
+#include <string.h>
+#include <time.h>
+#include "simlib.h" /* Required for use of simlib.c. */
+
+#define LIST_QUEUE 1         /* List used by the list benchmarks. */
+#define EVENT_BACKGROUND 1   /* Event type of the pending events that make up the calendar. */
+#define EVENT_DEPARTURE 2    /* Event type cancelled and rescheduled like the bus departure of carrental.c. */
+#define STREAM_TIME 1        /* Random-number stream for event times. */
+#define STREAM_KEY 2         /* Random-number stream for list ranking keys. */
+#define STREAM_BENCH 3       /* Random-number stream for the random-number benchmarks. */
+#define MIN_SIZE 10          /* Smallest calendar size. */
+#define MAX_SIZE 1000000     /* Default largest calendar size. */
+#define NUM_OPS 1000000      /* Default number of operations per benchmark. */
+#define INCREASING_STEPS 2e7 /* Budget of list steps for list_file(INCREASING, ...), which walks the list. */
+
+FILE *csvfile;
+const char *label = "";
+int backend = EVLIST_HEAP; // Event list backend the benchmarks run on.
+volatile double sink; // Keeps the compiler from dropping results that are otherwise unused.
+
+double now(void) /* Monotonic clock in seconds. */
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void record(const char *name, long size, long ops, double seconds) /* Report "ops" operations of benchmark "name" at "size" pending records. */
+{
+    double ns = seconds * 1e9 / ops;
+    printf("%-32s%10ld%12ld%14.1f%16.0f\n", name, size, ops, ns, 1e9 / ns);
+    fprintf(csvfile, "%s,%s,%ld,%ld,%.3f,%.0f\n", label, name, size, ops, ns, 1e9 / ns);
+}
+
+void setup(void) /* Start a fresh simulation. */
+{
+    maxatr = 4;
+    init_simlib();
+    event_backend(backend);
+    list_rank[LIST_QUEUE] = 1;
+}
+
+void fill_calendar(long size) /* Schedule "size" background events. */
+{
+    long i;
+    for (i = 0; i < size; i++)
+        event_schedule(sim_time + expon(1.0, STREAM_TIME), EVENT_BACKGROUND);
+}
+
+long batch_size(long size) /* Number of operations timed in one batch at "size" pending records: a tenth of the size, and at least MIN_SIZE. */
+{
+    return size / 10 < MIN_SIZE ? MIN_SIZE : size / 10;
+}
+
+void bench_calendar(long size, long num_ops) /* event_schedule and timing: batches that grow the calendar from "size" and drain it back. */
+{
+    long batch = batch_size(size), done, i;
+    double schedule_time = 0.0, timing_time = 0.0, start;
+
+    setup();
+    fill_calendar(size);
+    for (done = 0; done < num_ops; done += batch) {
+        start = now();
+        for (i = 0; i < batch; i++)
+            event_schedule(sim_time + expon(1.0, STREAM_TIME), EVENT_BACKGROUND);
+        schedule_time += now() - start;
+        start = now();
+        for (i = 0; i < batch; i++)
+            timing();
+        timing_time += now() - start;
+    }
+    record("event_schedule", size, done, schedule_time);
+    record("timing", size, done, timing_time);
+}
+
+void bench_hold(long size, long num_ops) /* The hold model: take the next event and schedule a new one, so the calendar stays at "size". */
+{
+    long i;
+    double start;
+
+    setup();
+    fill_calendar(size);
+    start = now();
+    for (i = 0; i < num_ops; i++) {
+        timing();
+        event_schedule(sim_time + expon(1.0, STREAM_TIME), EVENT_BACKGROUND);
+    }
+    record("hold (timing+event_schedule)", size, num_ops, now() - start);
+}
+
+void bench_cancel(long size, long num_ops) /* Cancel the pending departure and reschedule it, as carrental.c does whenever the bus starts loading or unloading. */
+{
+    long long handle;
+    long i;
+    double start;
+
+    setup();
+    fill_calendar(size);
+    event_schedule(sim_time + expon(1.0, STREAM_TIME), EVENT_DEPARTURE);
+    start = now();
+    for (i = 0; i < num_ops; i++) {
+        event_cancel(EVENT_DEPARTURE);
+        event_schedule(sim_time + expon(1.0, STREAM_TIME), EVENT_DEPARTURE);
+    }
+    record("event_cancel+schedule", size, num_ops, now() - start);
+
+    handle = event_schedule(sim_time + expon(1.0, STREAM_TIME), EVENT_DEPARTURE);
+    start = now();
+    for (i = 0; i < num_ops; i++) {
+        event_cancel_handle(handle);
+        handle = event_schedule(sim_time + expon(1.0, STREAM_TIME), EVENT_DEPARTURE);
+    }
+    record("event_cancel_handle+schedule", size, num_ops, now() - start);
+}
+
+void fill_list(long size) /* File "size" records on the queue list in increasing order of their key. */
+{
+    long i;
+    for (i = 0; i < size; i++) {
+        transfer[1] = (double)i / size;
+        list_file(LAST, LIST_QUEUE);
+    }
+}
+
+void bench_list(long size, long num_ops) /* list_file and list_remove: batches that grow the queue from "size" and shrink it back. */
+{
+    long batch = batch_size(size), done, i;
+    double first_time = 0.0, last_time = 0.0, remove_time = 0.0, start;
+
+    // Filing FIRST and removing FIRST is a stack; filing LAST and removing FIRST is the FIFO queue of carrental.c.
+    setup();
+    fill_list(size);
+    for (done = 0; done < num_ops; done += batch) {
+        start = now();
+        for (i = 0; i < batch; i++) {
+            transfer[1] = 0.0;
+            list_file(FIRST, LIST_QUEUE);
+        }
+        first_time += now() - start;
+        for (i = 0; i < batch; i++)
+            list_remove(FIRST, LIST_QUEUE);
+        start = now();
+        for (i = 0; i < batch; i++) {
+            transfer[1] = 1.0;
+            list_file(LAST, LIST_QUEUE);
+        }
+        last_time += now() - start;
+        start = now();
+        for (i = 0; i < batch; i++)
+            list_remove(FIRST, LIST_QUEUE);
+        remove_time += now() - start;
+    }
+    record("list_file(FIRST)", size, done, first_time);
+    record("list_file(LAST)", size, done, last_time);
+    record("list_remove(FIRST)", size, done, remove_time);
+}
+
+void bench_fifo(long size, long num_ops) /* The FIFO queue of bench_list again, on a list declared FIFO with list_fifo. */
+{
+    long batch = batch_size(size), done, i;
+    double file_time = 0.0, remove_time = 0.0, start;
+
+    setup();
+    list_fifo(LIST_QUEUE);
+    fill_list(size);
+    for (done = 0; done < num_ops; done += batch) {
+        start = now();
+        for (i = 0; i < batch; i++) {
+            transfer[1] = 1.0;
+            list_file(LAST, LIST_QUEUE);
+        }
+        file_time += now() - start;
+        start = now();
+        for (i = 0; i < batch; i++)
+            list_remove(FIRST, LIST_QUEUE);
+        remove_time += now() - start;
+    }
+    record("list_file(LAST) FIFO list", size, done, file_time);
+    record("list_remove(FIRST) FIFO list", size, done, remove_time);
+}
+
+void bench_append(long size, long num_ops, int fifo) /* The FIFO queue of bench_list again, through list_append and list_pop_front, on a list declared FIFO if "fifo". */
+{
+    long batch = batch_size(size), done, i;
+    double file_time = 0.0, remove_time = 0.0, start;
+
+    setup();
+    if (fifo)
+        list_fifo(LIST_QUEUE);
+    fill_list(size);
+    for (done = 0; done < num_ops; done += batch) {
+        start = now();
+        for (i = 0; i < batch; i++) {
+            transfer[1] = 1.0;
+            list_append(LIST_QUEUE);
+        }
+        file_time += now() - start;
+        start = now();
+        for (i = 0; i < batch; i++)
+            list_pop_front(LIST_QUEUE);
+        remove_time += now() - start;
+    }
+    record(fifo ? "list_append FIFO list" : "list_append", size, done, file_time);
+    record(fifo ? "list_pop_front FIFO list" : "list_pop_front", size, done, remove_time);
+}
+
+void bench_increasing(long size, long num_ops) /* list_file(INCREASING) of a random key, then list_remove(FIRST) to keep the queue at "size". */
+{
+    long i;
+    double start;
+
+    // Filing in order walks the list, so the number of operations is cut to keep the run time bounded at the large sizes.
+    if (num_ops > INCREASING_STEPS / size)
+        num_ops = INCREASING_STEPS / size < MIN_SIZE ? MIN_SIZE : INCREASING_STEPS / size;
+    setup();
+    fill_list(size);
+    start = now();
+    for (i = 0; i < num_ops; i++) {
+        transfer[1] = lcgrand(STREAM_KEY);
+        list_file(INCREASING, LIST_QUEUE);
+        list_remove(FIRST, LIST_QUEUE);
+    }
+    record("list_file(INCREASING)+remove", size, num_ops, now() - start);
+}
+
+void bench_statistics(long num_ops) /* sampst and timest, whose cost does not depend on the calendar size. */
+{
+    long i;
+    double start;
+
+    setup();
+    start = now();
+    for (i = 0; i < num_ops; i++)
+        sampst((double)(i & 1023), 1);
+    record("sampst", 0, num_ops, now() - start);
+
+    start = now();
+    for (i = 0; i < num_ops; i++) {
+        sim_time += 0.5;
+        timest((double)(i & 31), 1);
+    }
+    record("timest", 0, num_ops, now() - start);
+}
+
+void bench_random(long num_ops) /* lcgrand and expon. */
+{
+    long i;
+    double start, sum = 0.0;
+
+    setup();
+    start = now();
+    for (i = 0; i < num_ops; i++)
+        sum += lcgrand(STREAM_BENCH);
+    record("lcgrand", 0, num_ops, now() - start);
+
+    start = now();
+    for (i = 0; i < num_ops; i++)
+        sum += expon(1.0, STREAM_BENCH);
+    record("expon", 0, num_ops, now() - start);
+    sink = sum;
+}
+
+int main(int argc, char *argv[]) /* Main function. */
+{
+    const char *csvname = "simbench.csv";
+    long max_size = MAX_SIZE, num_ops = NUM_OPS, size;
+    int i;
+
+    /* Read the options: -s S benchmarks calendar sizes 10, 100, ... up to S, -n N times N operations per benchmark, -o F writes the CSV to F,
+       -l L tags its rows with L (the commit, say) and -E B keeps the events in backend B of simlib (heap or calendar). */
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            max_size = atol(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            num_ops = atol(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            csvname = argv[++i];
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+            label = argv[++i];
+        else if (strcmp(argv[i], "-E") == 0 && i + 1 < argc) {
+            i++;
+            backend = strcmp(argv[i], "heap") == 0 ? EVLIST_HEAP : strcmp(argv[i], "calendar") == 0 ? EVLIST_CALENDAR : 0;
+        }
+        else {
+            fprintf(stderr, "usage: %s [-s max_size] [-n operations] [-o csv_file] [-l label] [-E heap|calendar]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (max_size < MIN_SIZE || num_ops < 1 || backend == 0) {
+        fprintf(stderr, "%s: need a largest size of at least %d, at least one operation and an event list of heap or calendar\n", argv[0], MIN_SIZE);
+        return 1;
+    }
+
+    /* Open output files. */
+
+    csvfile = fopen(csvname, "w");
+    if (csvfile == NULL) {
+        perror(csvname);
+        return 1;
+    }
+    fprintf(csvfile, "label,benchmark,size,ops,ns_per_op,ops_per_sec\n");
+
+    /* Run the benchmarks. */
+
+    printf("%-32s%10s%12s%14s%16s\n", "Benchmark", "Size", "Ops", "ns/op", "ops/sec");
+    bench_statistics(num_ops);
+    bench_random(num_ops);
+    for (size = MIN_SIZE; size <= max_size; size *= 10) {
+        bench_calendar(size, num_ops);
+        bench_hold(size, num_ops);
+        bench_cancel(size, num_ops);
+        bench_list(size, num_ops);
+        bench_fifo(size, num_ops);
+        bench_append(size, num_ops, 0);
+        bench_append(size, num_ops, 1);
+        bench_increasing(size, num_ops);
+    }
+
+    fclose(csvfile);
+    free_simlib();
+
+    return 0;
+}
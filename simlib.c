@@ -5,132 +5,471 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
-#include "simlibdefs.h"
+#include <string.h>
+#ifdef SIMLIB_PROFILE
+#include <time.h>
+#endif
+#ifdef SIMLIB_TRACE
+#include <stddef.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#define SIMLIB_SOURCE
+#include "simlib.h"
+
+/* The complete state of a simulation lives in a struct sim_ctx (see
+   simlib.h), which every sim_ function takes as its first argument, so that
+   independent simulations can run side by side, e.g., one per thread.  The
+   classic simlib interface (init_simlib, list_file, sim_time, transfer, ...)
+   is kept as a thin layer over the context in sim_current, which each thread
+   sets with sim_ctx_bind and which starts out as a process-wide default
+   context. */
+
+/* The event list (LIST_EVENT) is not kept as a linked list of struct master
+   records but as a binary min-heap, ordered on the event time and then on the
+   order in which the events were filed, so that ties are resolved FIFO exactly
+   as list_file (INCREASING, LIST_EVENT) used to do.  head[LIST_EVENT] and
+   tail[LIST_EVENT] are therefore always NULL; list_size[LIST_EVENT] and the
+   timest statistics for the event list are maintained as before.
+
+   Every pending event occupies a slot in event_slot, which knows where the
+   event sits in the heap, so that an event can be removed given its handle
+   (slot number plus a generation count that makes stale handles harmless;
+   the generations wrap at EVENT_GEN_MAX, so that handles are always positive).
+   The slots of the pending events of each type are also chained together,
+   so that event_cancel only looks at events of the requested type. */
+
+struct event_entry
+{
+  double time;			/* Copy of value[EVENT_TIME], the heap key. */
+  unsigned long seq;		/* Filing order, used to break ties FIFO. */
+  int slot;			/* Slot of this event in event_slot. */
+};
 
-/* Declare simlib global variables. */
+#define EVENT_GEN_MAX 0x7fffffffu	/* Last generation of a slot before it wraps to 1. */
 
-int *list_rank, *list_size, next_event_type, maxatr = 0, maxlist = 0;
-double *transfer, sim_time, prob_distrib[26];
-struct master
+struct event_slot
 {
-  double *value;
-  struct master *pr;
-  struct master *sr;
-} **head, **tail;
+  double *value;		/* The attributes of the event. */
+  unsigned int gen;		/* Generation, bumped when the slot is freed. */
+  int pos;			/* Position in event_heap (bucket in the calendar), or -1 if free. */
+  int type;			/* Event type, or next free slot if free. */
+  int tprev, tnext;		/* Neighbours in the chain of this type. */
+};
+
+/* With event_backend (EVLIST_CALENDAR), the heap gives way to a calendar
+   queue (R. Brown, Comm. ACM 31, 1988).  Time is cut into days of "width"
+   time units, and day d falls in bucket d mod nbuckets, so the buckets hold
+   a year of nbuckets days that wraps around.  Each bucket chains its events
+   through their slots, sorted on time and filing order.  timing takes the
+   first event of the bucket of the current day if it is due that day, or
+   else moves on to the next day; event_schedule only walks the bucket of
+   the new event.  With days about as long as the gaps between the events
+   due next, both take O(1) expected time however many events are pending,
+   against O(log n) for the heap.  The number of buckets is doubled (halved)
+   when the events outnumber twice (fall below half) the buckets, and the
+   width is then set anew from the earliest events; it is also set anew when
+   a whole year goes by without an event.  event_heap then keeps the key of
+   each pending event at the index of its slot, and the pos of the slot is
+   its bucket.  Both backends dispatch the events in the same order, so a
+   run gives the same results with either. */
+
+#define CAL_MIN      16		/* Fewest buckets. */
+#define CAL_SAMPLE   25		/* Earliest events whose gaps set the width. */
+#define CAL_FAR    1e18		/* Day of all the events too far out to count days to. */
+
+struct sim_calendar
+{
+  int *bucket;			/* First slot of each bucket, or -1. */
+  int *next, *prev;		/* Neighbours of each slot in its bucket, or -1. */
+  int nbuckets;			/* Number of buckets, a power of 2. */
+  double width;			/* Time units per day. */
+  long long today;		/* Day whose bucket timing looks at first. */
+};
+
+/* List records and attribute blocks (the arrays that transfer points to) are
+   taken from two pools (struct pool, see simlib.h) owned by the context
+   instead of being malloc'ed and freed one at a time.  Each pool hands out
+   fixed-size blocks carved from large chunks, keeps released blocks on a free
+   list for reuse, and gives all its chunks back at once in sim_release.
+   Attribute blocks are maxatr + 1 doubles wide, maxatr being taken when
+   sim_init is called; maxatr may be lowered afterwards but not raised. */
+
+#define POOL_CHUNK  1024	/* Number of blocks carved from one chunk. */
+
+/* A list declared FIFO by list_fifo may only be filed LAST and removed FIRST.
+   Its records are kept by value in a ring buffer (struct fifo, see simlib.h)
+   of whole attribute blocks, which doubles in size whenever it fills up, so
+   filing and removing cost a copy of one block and no allocation at all.
+   head[list] and tail[list] of a FIFO list are always NULL; list_size and the
+   timest statistics for the list are maintained as before. */
+
+#define FIFO_START  16		/* Initial number of records in a ring buffer. */
+
+/* When simlib is compiled with SIMLIB_PROFILE defined, every context keeps a
+   profile of its run (struct sim_profile): for each event type, the number of
+   times it was scheduled, cancelled and dispatched by timing, and the wall
+   time spent on it, taken as the time from its dispatch to the next call of
+   timing, as a total and as a histogram of power-of-two buckets of
+   nanoseconds; also the peak length of every list.  out_profile writes it.
+   Without SIMLIB_PROFILE none of this is compiled in. */
+
+#ifdef SIMLIB_PROFILE
+
+#define PROF_TYPES    32	/* Event types profiled one by one; the higher ones share the last entry. */
+#define PROF_BUCKETS  32	/* Histogram buckets, up to 2^31 ns and more. */
+
+struct prof_type
+{
+  long scheduled, cancelled, dispatched;
+  double seconds;		/* Total wall time of the dispatched events. */
+  long hist[PROF_BUCKETS];	/* hist[k] counts times in [2^k, 2^(k+1)) ns. */
+};
+
+struct sim_profile
+{
+  struct prof_type type[PROF_TYPES];
+  int *peak;			/* Peak length of each list. */
+  int current;			/* Type of the event being handled, or -1. */
+  struct timespec start;	/* When it was dispatched. */
+};
+
+#define PROF_TYPE(type) ((type) < PROF_TYPES - 1 ? (type) : PROF_TYPES - 1)
+
+#endif
+
+/* When simlib is compiled with SIMLIB_TRACE defined, trace_open makes timing
+   append a fixed-size binary record (struct trace_record, see simlib.h) for
+   every event it dispatches to a trace file: its time, type and attributes 3
+   and 4 (as floats), and the lengths of the event list and of lists 1
+   through the number asked for, at most TRACE_LISTS (capped at
+   TRACE_LENGTH_MAX).  A record is cut after the last of those lengths, so it
+   takes 24 bytes with up to 2 lists and 40 with TRACE_LISTS.  The file is a
+   struct trace_header followed by the records.  It grows a large chunk of
+   records at a time, allocated on disk with posix_fallocate so that writing
+   a page does not have to find blocks for it, and only the chunk being
+   filled is mapped, so a record costs a few stores and the old chunks are
+   never remapped.  (Faulting a whole chunk in at once with MAP_POPULATE was
+   slower: the pages it zeroes leave the cache before they are written.)
+   The count in the header, mapped apart, is kept up to date, so the records
+   written are readable even if the run dies; trace_close cuts the file to
+   them.  Without SIMLIB_TRACE none of this is compiled in and trace_open
+   fails.  traceread.c prints trace files. */
+
+#ifdef SIMLIB_TRACE
+
+struct sim_trace
+{
+  int fd;			/* The trace file. */
+  struct trace_header *header;	/* Mapping of its header. */
+  int lists;			/* Lists whose lengths a record holds. */
+  size_t record_size;		/* Bytes per record. */
+  char *chunk;			/* Where record 0 would be if the chunk mapped held it. */
+  void *map;			/* Mapping of the chunk, from a page boundary. */
+  size_t map_bytes;		/* Its length. */
+  long long end;		/* Records in the file. */
+  long long records;		/* Records in a chunk. */
+};
+
+#define TRACE_RECORD_SIZE(lists) ((offsetof (struct trace_record, length) + (lists) * sizeof (unsigned short) \
+				   + sizeof (double) - 1) / sizeof (double) * sizeof (double))
+#define TRACE_BYTES(tr, records) (sizeof (struct trace_header) + (records) * (tr)->record_size)
+
+#endif
+
+/* Declare the default context and the current context of each thread. */
+
+static struct sim_ctx sim_default;
+_Thread_local struct sim_ctx *sim_current = &sim_default;
 
 /* Declare simlib functions. */
 
-void init_simlib (void);
-void list_file (int option, int list);
-void list_remove (int option, int list);
-void timing (void);
-void event_schedule (double time_of_event, int type_of_event);
-int event_cancel (int event_type);
-double sampst (double value, int variable);
-double timest (double value, int variable);
-double filest (int list);
-void out_sampst (FILE * unit, int lowvar, int highvar);
-void out_timest (FILE * unit, int lowvar, int highvar);
-void out_filest (FILE * unit, int lowlist, int highlist);
-void pprint_out (FILE * unit, int i);
-double expon (double mean, int stream);
-int random_integer (double prob_distrib[], int stream);
-double uniform (double a, double b, int stream);
-double erlang (int m, double mean, int stream);
-double lcgrand (int stream);
-void lcgrandst (long zset, int stream);
-long lcgrandgt (int stream);
-
-void
-init_simlib ()
-{
-
-/* Initialize simlib.c.  List LIST_EVENT is reserved for event list, ordered by
-   event time.  init_simlib must be called from main by user. */
+struct sim_ctx *sim_ctx_new (void);
+void sim_ctx_delete (struct sim_ctx *ctx);
+void sim_ctx_bind (struct sim_ctx *ctx);
+void sim_init (struct sim_ctx *ctx);
+void sim_list_file (struct sim_ctx *ctx, int option, int list);
+void sim_list_remove (struct sim_ctx *ctx, int option, int list);
+void sim_list_append (struct sim_ctx *ctx, int list);
+void sim_list_prepend (struct sim_ctx *ctx, int list);
+void sim_list_insert_increasing (struct sim_ctx *ctx, int list);
+void sim_list_insert_decreasing (struct sim_ctx *ctx, int list);
+void sim_list_pop_front (struct sim_ctx *ctx, int list);
+void sim_list_pop_back (struct sim_ctx *ctx, int list);
+void sim_list_file_at (struct sim_ctx *ctx, int option, int list, double time);
+void sim_list_remove_at (struct sim_ctx *ctx, int option, int list, double time);
+long long sim_event_insert_ranked (struct sim_ctx *ctx);
+void sim_list_fifo (struct sim_ctx *ctx, int list);
+void sim_timing (struct sim_ctx *ctx);
+long long sim_event_schedule (struct sim_ctx *ctx, double time_of_event, int type_of_event);
+int sim_event_cancel (struct sim_ctx *ctx, int event_type);
+int sim_event_cancel_handle (struct sim_ctx *ctx, long long handle);
+void sim_event_backend (struct sim_ctx *ctx, int kind);
+double sim_sampst (struct sim_ctx *ctx, double value, int variable);
+double sim_timest (struct sim_ctx *ctx, double value, int variable);
+void sim_sampst_at (struct sim_ctx *ctx, double value, int variable, double time);
+void sim_timest_at (struct sim_ctx *ctx, double value, int variable, double time);
+double sim_filest (struct sim_ctx *ctx, int list);
+double sim_sampst_ci (struct sim_ctx *ctx, int variable);
+void sim_sampst_track (struct sim_ctx *ctx, int variable, double p);
+double sim_sampst_quantile (struct sim_ctx *ctx, int variable, double p);
+double sim_timest_ci (struct sim_ctx *ctx, int variable);
+double sim_filest_ci (struct sim_ctx *ctx, int list);
+void sim_reset_stats (struct sim_ctx *ctx);
+void sim_warmup_sampst (struct sim_ctx *ctx, int variable);
+void sim_warmup_timest (struct sim_ctx *ctx, int variable);
+void sim_warmup_filest (struct sim_ctx *ctx, int list);
+double sim_warmup_end (struct sim_ctx *ctx);
+void sim_out_sampst (struct sim_ctx *ctx, FILE * unit, int lowvar, int highvar);
+void sim_out_timest (struct sim_ctx *ctx, FILE * unit, int lowvar, int highvar);
+void sim_out_filest (struct sim_ctx *ctx, FILE * unit, int lowlist, int highlist);
+double sim_expon (struct sim_ctx *ctx, double mean, int stream);
+int sim_random_integer (struct sim_ctx *ctx, double prob_distrib[], int stream);
+int sim_random_alias (struct sim_ctx *ctx, const struct alias_table *table, int stream);
+void alias_setup (struct alias_table *table, const double prob[], int n);
+double sim_uniform (struct sim_ctx *ctx, double a, double b, int stream);
+double sim_erlang (struct sim_ctx *ctx, int m, double mean, int stream);
+double sim_lcgrand (struct sim_ctx *ctx, int stream);
+void sim_lcgrandst (struct sim_ctx *ctx, long zset, int stream);
+long sim_lcgrandgt (struct sim_ctx *ctx, int stream);
+void sim_lcgrandvs (struct sim_ctx *ctx, long vstream, int stream);
+void sim_lcgrand_fill (struct sim_ctx *ctx, int stream, double u[], int n);
+void sim_expon_fill (struct sim_ctx *ctx, double mean, int stream, double x[], int n);
+void sim_uniform_fill (struct sim_ctx *ctx, double a, double b, int stream, double x[], int n);
+double sim_mrgrand (struct sim_ctx *ctx, int stream);
+void sim_mrgrandss (struct sim_ctx *ctx, long long substream, int stream);
+void sim_mrgrandns (struct sim_ctx *ctx, int stream);
+void sim_mrgrandsd (struct sim_ctx *ctx, unsigned long seed[6]);
+void sim_rng_select (struct sim_ctx *ctx, int kind);
+void sim_rng_antithetic (struct sim_ctx *ctx, int on);
+void sim_out_profile (struct sim_ctx *ctx, FILE * unit);
+int sim_checkpoint (struct sim_ctx *ctx, const char *path, const void *user, size_t user_size);
+int sim_restore (struct sim_ctx *ctx, const char *path, void *user, size_t user_size);
+double student_t95 (int df);
+long sim_pool_avoided (struct sim_ctx *ctx);
+void sim_release (struct sim_ctx *ctx);
+static void pprint_out (struct sim_ctx *ctx, FILE * unit, int i);
+static void batch_add (struct sim_ctx *ctx, struct batch_means *batch, double mean);
+static int mser_truncation (struct batch_means *batch);
+static double batch_half_width (struct batch_means *batch);
+static void timest_advance (struct sim_ctx *ctx, struct timest_acc *acc);
+static void sampst_clear (struct sampst_acc *acc);
+static inline void timest_update (struct sim_ctx *ctx, struct timest_acc *acc, double value);
+static void timest_clear (struct sim_ctx *ctx, struct timest_acc *acc);
+static void timest_restart (struct sim_ctx *ctx, struct timest_acc *acc);
+static inline struct sampst_acc *sampst_var (struct sim_ctx *ctx, int variable);
+static inline struct timest_acc *timest_var (struct sim_ctx *ctx, int variable);
+static void sampst_grow (struct sim_ctx *ctx, int variable);
+static void timest_grow (struct sim_ctx *ctx, int variable);
+static void lists_grow (struct sim_ctx *ctx, int list);
+static double clock_back (struct sim_ctx *ctx, double time, double last);
+static void *grow_array (void *array, int old, int n, size_t size);
+static void p2_add (struct p2_quantile *quant, double value);
+static void ckpt_sizes (size_t sizes[6]);
+static int ckpt_take (char **cursor, char *end, void *to, size_t size);
+static double p2_estimate (struct p2_quantile *quant);
+static inline void fifo_file (struct sim_ctx *ctx, int option, int list);
+static inline void fifo_remove (struct sim_ctx *ctx, int option, int list);
+static void fifo_free (struct sim_ctx *ctx);
+#ifdef SIMLIB_PROFILE
+static void prof_close (struct sim_ctx *ctx);
+#endif
+#ifdef SIMLIB_TRACE
+static void trace_event (struct sim_ctx *ctx);
+#endif
+static long long event_insert (struct sim_ctx *ctx, int type);
+static void event_delete (struct sim_ctx *ctx, int slot);
+static inline int event_precedes (const struct event_entry *a, const struct event_entry *b);
+static inline struct event_entry *event_key (struct sim_ctx *ctx, int slot);
+static inline int event_first (struct sim_ctx *ctx);
+static int event_last (struct sim_ctx *ctx);
+static void cal_reset (struct sim_ctx *ctx);
+static void cal_links (struct sim_ctx *ctx);
+static void cal_free (struct sim_ctx *ctx);
+static inline long long cal_day (struct sim_calendar *cal, double time);
+static void cal_insert (struct sim_ctx *ctx, int slot);
+static void cal_remove (struct sim_ctx *ctx, int slot, int bucket);
+static int cal_first (struct sim_ctx *ctx);
+static void cal_resize (struct sim_ctx *ctx, int nbuckets);
+static double cal_width (double times[], int n, double width);
+static void cal_restore (struct sim_ctx *ctx, int n);
+static void event_sift_up (struct sim_ctx *ctx, int i);
+static void event_sift_down (struct sim_ctx *ctx, int i);
+static void pool_init (struct pool *pool, size_t size);
+static void *pool_get (struct pool *pool);
+static void pool_put (struct pool *pool, void *block);
+static void pool_free (struct pool *pool);
+static double *value_get (struct sim_ctx *ctx);
+static inline double urand (struct sim_ctx *ctx, int stream);
+static void urand_fill (struct sim_ctx *ctx, int stream, double u[], int n);
 
-  int list, listsize;
+void
+sim_init (struct sim_ctx *ctx)
+{
 
-  if (maxlist < 1)
-    maxlist = MAX_LIST;
-  listsize = maxlist + 1;
+/* Initialize context ctx.  List LIST_EVENT is reserved for event list, ordered
+   by event time.  sim_init (or init_simlib for the current context) must be
+   called by user before the context is used.  It allocates lists 0 through
+   maxlist (MAX_LIST if maxlist is not set), MAX_SVAR sampst variables and
+   MAX_TVAR timest variables; lists and variables numbered higher are added
+   when they are first used. */
 
-  /* Initialize system attributes. */
+  int list, listsize;
 
-  sim_time = 0.0;
-  if (maxatr < 4)
-    maxatr = MAX_ATTR;
+  if (ctx->maxlist < 1)
+    ctx->maxlist = MAX_LIST;
+  listsize = ctx->maxlist + 1;
 
-  /* Allocate space for the lists. */
+  /* Initialize system attributes. */
 
-  list_rank = (int *) calloc (listsize, sizeof (int));
-  list_size = (int *) calloc (listsize, sizeof (int));
-  head = (struct master **) calloc (listsize, sizeof (struct master *));
-  tail = (struct master **) calloc (listsize, sizeof (struct master *));
-  transfer = (double *) calloc (maxatr + 1, sizeof (double));
+  ctx->sim_time = 0.0;
+  if (ctx->maxatr < 4)
+    ctx->maxatr = MAX_ATTR;
+
+  /* Allocate space for the lists, releasing that of an earlier run. */
+
+  free (ctx->list_rank);
+  free (ctx->list_size);
+  free (ctx->head);
+  free (ctx->tail);
+  free (ctx->list_timest);
+  fifo_free (ctx);
+  ctx->list_rank = (int *) calloc (listsize, sizeof (int));
+  ctx->list_size = (int *) calloc (listsize, sizeof (int));
+  ctx->head = (struct master **) calloc (listsize, sizeof (struct master *));
+  ctx->tail = (struct master **) calloc (listsize, sizeof (struct master *));
+  ctx->fifo = (struct fifo *) calloc (listsize, sizeof (struct fifo));
+  ctx->fifo_lists = listsize;
+  ctx->list_timest = (struct timest_acc *) calloc (listsize, sizeof (struct timest_acc));
+#ifdef SIMLIB_PROFILE
+  if (ctx->profile != NULL)
+    free (ctx->profile->peak);
+  free (ctx->profile);
+  ctx->profile = (struct sim_profile *) calloc (1, sizeof (struct sim_profile));
+  ctx->profile->peak = (int *) calloc (listsize, sizeof (int));
+  ctx->profile->current = -1;
+#endif
+  pool_init (&ctx->row_pool, sizeof (struct master));
+  pool_init (&ctx->value_pool, (ctx->maxatr + 1) * sizeof (double));
+  ctx->transfer = value_get (ctx);
 
   /* Initialize list attributes. */
 
-  for (list = 1; list <= maxlist; ++list)
+  for (list = 1; list <= ctx->maxlist; ++list)
     {
-      head[list] = NULL;
-      tail[list] = NULL;
-      list_size[list] = 0;
-      list_rank[list] = 0;
+      ctx->head[list] = NULL;
+      ctx->tail[list] = NULL;
+      ctx->list_size[list] = 0;
+      ctx->list_rank[list] = 0;
     }
 
   /* Set event list to be ordered by event time. */
 
-  list_rank[LIST_EVENT] = EVENT_TIME;
-
-  /* Initialize statistical routines. */
-
-  sampst (0.0, 0);
-  timest (0.0, 0);
+  ctx->list_rank[LIST_EVENT] = EVENT_TIME;
+  ctx->event_seq = 0;
+  ctx->event_free = -1;
+  if (ctx->event_heap == NULL)
+    {
+      ctx->event_max = 64;
+      ctx->event_heap = (struct event_entry *) malloc (ctx->event_max * sizeof (struct event_entry));
+      ctx->event_slot = (struct event_slot *) malloc (ctx->event_max * sizeof (struct event_slot));
+      ctx->type_max = 16;
+      ctx->type_first = (int *) malloc (ctx->type_max * sizeof (int));
+    }
+  for (list = 0; list < ctx->event_max; ++list)
+    {
+      ctx->event_slot[list].gen = 1;
+      ctx->event_slot[list].pos = -1;
+      ctx->event_slot[list].type = ctx->event_free;
+      ctx->event_free = list;
+    }
+  for (list = 0; list < ctx->type_max; ++list)
+    ctx->type_first[list] = -1;
+  cal_free (ctx);
+  if (ctx->event_kind == EVLIST_CALENDAR)
+    cal_reset (ctx);
+
+  /* Initialize statistical routines, tracking no quantiles and watching
+     nothing for the end of the warm-up. */
+
+  ctx->warmup_watched = 0;
+  ctx->warmup_pending = 0;
+  ctx->warmup_end = -1.0;
+
+  free (ctx->sampst);
+  free (ctx->timest);
+  ctx->sampst = NULL;
+  ctx->timest = NULL;
+  ctx->num_sampst = 0;
+  ctx->num_timest = 0;
+  sampst_grow (ctx, MAX_SVAR);
+  timest_grow (ctx, MAX_TVAR);
+  sim_sampst (ctx, 0.0, 0);
+  sim_timest (ctx, 0.0, 0);
 }
 
-void
-list_file (int option, int list)
+static inline void
+list_file_as (struct sim_ctx *ctx, int option, int list)
 {
 
-/* Place transfr into list "list".
-   Update timest statistics for the list.
-   option = FIRST place at start of list
-            LAST  place at end of list
-            INCREASING  place in increasing order on attribute list_rank(list)
-            DECREASING  place in decreasing order on attribute list_rank(list)
-            (ties resolved by FIFO) */
+/* Place transfer into list "list" as list_file does with option "option".
+   Every caller passes a constant option, so once this is inlined only the
+   code for that option is left; the checks of the list and of its rank are
+   only compiled in with SIMLIB_DEBUG (see sim_list_file). */
 
   struct master *row=NULL, *ahead, *behind, *ihead, *itail;
   int item, postest;
 
   /* If the list value is improper, stop the simulation. */
 
-  if (!((list >= 0) && (list <= MAX_LIST)))
+#ifdef SIMLIB_DEBUG
+  if (list < 0)
     {
-      printf ("\nInvalid list %d for list_file at time %f\n", list, sim_time);
+      printf ("\nInvalid list %d for list_file at time %f\n", list, ctx->sim_time);
       exit (1);
     }
+#endif
+
+  /* Add the list if it is the first time it is used. */
+
+  if (list > ctx->maxlist)
+    lists_grow (ctx, list);
 
   /* Increment the list size. */
 
-  list_size[list]++;
+  ctx->list_size[list]++;
+#ifdef SIMLIB_PROFILE
+  if (ctx->list_size[list] > ctx->profile->peak[list])
+    ctx->profile->peak[list] = ctx->list_size[list];
+#endif
 
-  /* If the option value is improper, stop the simulation. */
+  /* The event list is always ranked on EVENT_TIME, whatever the option. */
 
-  if (!((option >= 1) && (option <= DECREASING)))
+  if (list == LIST_EVENT)
     {
-      printf ("\n%d is an invalid option for list_file on list %d at time %f\n", option, list, sim_time);
-      exit (1);
+      event_insert (ctx, (int) floor (ctx->transfer[EVENT_TYPE] + 0.5));
+      timest_update (ctx, &ctx->list_timest[list], (double) ctx->list_size[list]);
+      return;
+    }
+
+  /* A FIFO list keeps its records in a ring buffer. */
+
+  if (ctx->fifo[list].rec != NULL)
+    {
+      fifo_file (ctx, option, list);
+      timest_update (ctx, &ctx->list_timest[list], (double) ctx->list_size[list]);
+      return;
     }
 
   /* If this is the first record in this list, just make space for it. */
 
-  if (list_size[list] == 1)
+  if (ctx->list_size[list] == 1)
     {
 
-      row = (struct master *) malloc (sizeof (struct master));
-      head[list] = row;
-      tail[list] = row;
+      row = (struct master *) pool_get (&ctx->row_pool);
+      ctx->head[list] = row;
+      ctx->tail[list] = row;
       (*row).pr = NULL;
       (*row).sr = NULL;
     }
@@ -142,54 +481,56 @@ list_file (int option, int list)
 
       if ((option == INCREASING) || (option == DECREASING))
 	{
-	  item = list_rank[list];
-	  if (!((item >= 1) && (item <= maxatr)))
+	  item = ctx->list_rank[list];
+#ifdef SIMLIB_DEBUG
+	  if (!((item >= 1) && (item <= ctx->maxatr)))
 	    {
-	      printf ("%d is an improper value for rank of list %d at time %f\n", item, list, sim_time);
+	      printf ("%d is an improper value for rank of list %d at time %f\n", item, list, ctx->sim_time);
 	      exit (1);
 	    }
+#endif
 
-	  row = head[list];
+	  row = ctx->head[list];
 	  behind = NULL;	/* Dummy value for the first iteration. */
 
 	  /* Search for the correct location. */
 
 	  if (option == INCREASING)
 	    {
-	      postest = (transfer[item] >= (*row).value[item]);
+	      postest = (ctx->transfer[item] >= (*row).value[item]);
 	      while (postest)
 		{
 		  behind = row;
 		  row = (*row).sr;
-		  postest = (behind != tail[list]);
+		  postest = (behind != ctx->tail[list]);
 		  if (postest)
-		    postest = (transfer[item] >= (*row).value[item]);
+		    postest = (ctx->transfer[item] >= (*row).value[item]);
 		}
 	    }
 
 	  else
 	    {
 
-	      postest = (transfer[item] <= (*row).value[item]);
+	      postest = (ctx->transfer[item] <= (*row).value[item]);
 	      while (postest)
 		{
 		  behind = row;
 		  row = (*row).sr;
-		  postest = (behind != tail[list]);
+		  postest = (behind != ctx->tail[list]);
 		  if (postest)
-		    postest = (transfer[item] <= (*row).value[item]);
+		    postest = (ctx->transfer[item] <= (*row).value[item]);
 		}
 	    }
 
 	  /* Check to see if position is first or last.  If so, take care of
 	     it below. */
 
-	  if (row == head[list])
+	  if (row == ctx->head[list])
 
 	    option = FIRST;
 
 	  else
-	   if (behind == tail[list])
+	   if (behind == ctx->tail[list])
 
 	    option = LAST;
 
@@ -197,7 +538,7 @@ list_file (int option, int list)
 	    {			/* Insert between preceding and succeeding records. */
 
 	      ahead = (*behind).sr;
-	      row = (struct master *) malloc (sizeof (struct master));
+	      row = (struct master *) pool_get (&ctx->row_pool);
 	      (*row).pr = behind;
 	      (*behind).sr = row;
 	      (*ahead).pr = row;
@@ -207,84 +548,93 @@ list_file (int option, int list)
 
       if (option == FIRST)
 	{
-	  row = (struct master *) malloc (sizeof (struct master));
-	  ihead = head[list];
+	  row = (struct master *) pool_get (&ctx->row_pool);
+	  ihead = ctx->head[list];
 	  (*ihead).pr = row;
 	  (*row).sr = ihead;
 	  (*row).pr = NULL;
-	  head[list] = row;
+	  ctx->head[list] = row;
 	}
       if (option == LAST)
 	{
-	  row = (struct master *) malloc (sizeof (struct master));
-	  itail = tail[list];
+	  row = (struct master *) pool_get (&ctx->row_pool);
+	  itail = ctx->tail[list];
 	  (*row).pr = itail;
 	  (*itail).sr = row;
 	  (*row).sr = NULL;
-	  tail[list] = row;
+	  ctx->tail[list] = row;
 	}
     }
 
   /* Copy the data. */
 
-  (*row).value = transfer;
+  (*row).value = ctx->transfer;
 
   /* Make room for new transfer. */
 
-  transfer = (double *) calloc (maxatr + 1, sizeof (double));
+  ctx->transfer = value_get (ctx);
 
   /* Update the area under the number-in-list curve. */
 
-  timest ((double) list_size[list], TIM_VAR + list);
+  timest_update (ctx, &ctx->list_timest[list], (double) ctx->list_size[list]);
 }
 
-void
-list_remove (int option, int list)
+static inline void
+list_remove_as (struct sim_ctx *ctx, int option, int list)
 {
 
-/* Remove a record from list "list" and copy attributes into transfer.
-   Update timest statistics for the list.
-   option = FIRST remove first record in the list
-            LAST  remove last record in the list */
+/* Remove a record from list "list" into transfer as list_remove does with
+   option "option", a constant at every call like that of list_file_as. */
 
   struct master *row = NULL, *ihead, *itail;
 
   /* If the list value is improper, stop the simulation. */
 
-  if (!((list >= 0) && (list <= MAX_LIST)))
+#ifdef SIMLIB_DEBUG
+  if (list < 0)
     {
-      printf ("\nInvalid list %d for list_remove at time %f\n", list, sim_time);
+      printf ("\nInvalid list %d for list_remove at time %f\n", list, ctx->sim_time);
       exit (1);
     }
+#endif
 
-  /* If the list is empty, stop the simulation. */
+  /* If the list is empty (or was never used), stop the simulation. */
 
-  if (list_size[list] <= 0)
+  if (list > ctx->maxlist || ctx->list_size[list] <= 0)
     {
-      printf ("\nUnderflow of list %d at time %f\n", list, sim_time);
+      printf ("\nUnderflow of list %d at time %f\n", list, ctx->sim_time);
       exit (1);
     }
 
   /* Decrement the list size. */
 
-  list_size[list]--;
+  ctx->list_size[list]--;
 
-  /* If the option value is improper, stop the simulation. */
+  /* Remove the earliest (FIRST) or the latest (LAST) event from the event
+     list. */
 
-  if (!(option == FIRST || option == LAST))
+  if (list == LIST_EVENT)
     {
-      printf ("\n%d is an invalid option for list_remove on list %d at time %f\n", option, list, sim_time);
-      exit (1);
+      event_delete (ctx, option == LAST ? event_last (ctx) : event_first (ctx));
+      timest_update (ctx, &ctx->list_timest[list], (double) ctx->list_size[list]);
+      return;
     }
 
-  if (list_size[list] == 0)
+  if (ctx->fifo[list].rec != NULL)
+    {
+      fifo_remove (ctx, option, list);
+      timest_update (ctx, &ctx->list_timest[list], (double) ctx->list_size[list]);
+      return;
+    }
+
+  if (ctx->list_size[list] == 0)
     {
 
       /* There is only 1 record, so remove it. */
 
-      row = head[list];
-      head[list] = NULL;
-      tail[list] = NULL;
+      row = ctx->head[list];
+      ctx->head[list] = NULL;
+      ctx->tail[list] = NULL;
     }
 
   else
@@ -299,526 +649,3748 @@ list_remove (int option, int list)
 	  /* Remove the first record in the list. */
 
 	case FIRST:
-	  row = head[list];
+	  row = ctx->head[list];
 	  ihead = (*row).sr;
 	  (*ihead).pr = NULL;
-	  head[list] = ihead;
+	  ctx->head[list] = ihead;
 	  break;
 
 	  /* Remove the last record in the list. */
 
 	case LAST:
-	  row = tail[list];
+	  row = ctx->tail[list];
 	  itail = (*row).pr;
 	  (*itail).sr = NULL;
-	  tail[list] = itail;
+	  ctx->tail[list] = itail;
 	  break;
 	}
     }
 
   /* Copy the data and free memory. */
 
-  free ((char *) transfer);
-  transfer = (*row).value;
-  free ((char *) row);
+  pool_put (&ctx->value_pool, ctx->transfer);
+  ctx->transfer = (*row).value;
+  pool_put (&ctx->row_pool, row);
 
   /* Update the area under the number-in-list curve. */
 
-  timest ((double) list_size[list], TIM_VAR + list);
+  timest_update (ctx, &ctx->list_timest[list], (double) ctx->list_size[list]);
 }
 
 void
-timing ()
+sim_list_file (struct sim_ctx *ctx, int option, int list)
 {
 
-/* Remove next event from event list, placing its attributes in transfer.
-   Set sim_time (simulation time) to event time, transfer[1].
-   Set next_event_type to this event type, transfer[2]. */
+/* Place transfr into list "list".
+   Update timest statistics for the list.
+   option = FIRST place at start of list
+            LAST  place at end of list
+            INCREASING  place in increasing order on attribute list_rank(list)
+            DECREASING  place in decreasing order on attribute list_rank(list)
+            (ties resolved by FIFO)
+   Model code that always passes the same option may call the entry point
+   for it instead (list_append and the others below), which skips this
+   dispatch.  The list number and rank are only checked with SIMLIB_DEBUG. */
 
-  /* Remove the first event from the event list and put it in transfer[]. */
+  switch (option)
+    {
+    case FIRST:
+      list_file_as (ctx, FIRST, list);
+      break;
+    case LAST:
+      list_file_as (ctx, LAST, list);
+      break;
+    case INCREASING:
+      list_file_as (ctx, INCREASING, list);
+      break;
+    case DECREASING:
+      list_file_as (ctx, DECREASING, list);
+      break;
+    default:
+      printf ("\n%d is an invalid option for list_file on list %d at time %f\n", option, list, ctx->sim_time);
+      exit (1);
+    }
+}
 
-  list_remove (FIRST, LIST_EVENT);
+void
+sim_list_remove (struct sim_ctx *ctx, int option, int list)
+{
 
-  /* Check for a time reversal. */
+/* Remove a record from list "list" and copy attributes into transfer.
+   Update timest statistics for the list.
+   option = FIRST remove first record in the list
+            LAST  remove last record in the list
+   list_pop_front and list_pop_back are the same for a fixed option. */
 
-  if (transfer[EVENT_TIME] < sim_time)
+  switch (option)
     {
-      printf ("\nAttempt to schedule event type %f for time %f at time %f\n",
-	      transfer[EVENT_TYPE], transfer[EVENT_TIME], sim_time);
+    case FIRST:
+      list_remove_as (ctx, FIRST, list);
+      break;
+    case LAST:
+      list_remove_as (ctx, LAST, list);
+      break;
+    default:
+      printf ("\n%d is an invalid option for list_remove on list %d at time %f\n", option, list, ctx->sim_time);
       exit (1);
     }
+}
 
-  /* Advance the simulation clock and set the next event type. */
+/* Entry points for one option of list_file and list_remove each. */
 
-  sim_time = transfer[EVENT_TIME];
-  next_event_type = transfer[EVENT_TYPE];
+void
+sim_list_append (struct sim_ctx *ctx, int list)
+{
+  list_file_as (ctx, LAST, list);
 }
 
 void
-event_schedule (double time_of_event, int type_of_event)
+sim_list_prepend (struct sim_ctx *ctx, int list)
 {
+  list_file_as (ctx, FIRST, list);
+}
 
-/* Schedule an event at time event_time of type event_type.  If attributes
-   beyond the first two (reserved for the event time and the event type) are
-   being used in the event list, it is the user's responsibility to place their
-   values into the transfer array before invoking event_schedule. */
+void
+sim_list_insert_increasing (struct sim_ctx *ctx, int list)
+{
+  list_file_as (ctx, INCREASING, list);
+}
 
-  transfer[EVENT_TIME] = time_of_event;
-  transfer[EVENT_TYPE] = type_of_event;
-  list_file (INCREASING, LIST_EVENT);
+void
+sim_list_insert_decreasing (struct sim_ctx *ctx, int list)
+{
+  list_file_as (ctx, DECREASING, list);
 }
 
-int
-event_cancel (int event_type)
+void
+sim_list_pop_front (struct sim_ctx *ctx, int list)
 {
+  list_remove_as (ctx, FIRST, list);
+}
 
-/* Remove the first event of type event_type from the event list, leaving its
-   attributes in transfer.  If something is cancelled, event_cancel returns 1;
-   if no match is found, event_cancel returns 0. */
+void
+sim_list_pop_back (struct sim_ctx *ctx, int list)
+{
+  list_remove_as (ctx, LAST, list);
+}
 
-  struct master *row, *ahead, *behind;
-  static double high, low, value;
+void
+sim_list_file_at (struct sim_ctx *ctx, int option, int list, double time)
+{
 
-  /* If the event list is empty, do nothing and return 0. */
+/* Place transfer into list "list" as list_file does, but as of the earlier
+   time "time" (see list_remove_at).  A model that leaves changes nobody
+   looks at until later, such as arrivals to a queue, may make them in a
+   batch this way, as long as it makes them in order of time. */
 
-  if (list_size[LIST_EVENT] == 0)
-    return 0;
+  double now;
+
+  now = clock_back (ctx, time, list >= 0 && list <= ctx->maxlist ? ctx->list_timest[list].tlvc : time);
+  sim_list_file (ctx, option, list);
+  ctx->sim_time = now;
+}
 
-  /* Search the event list. */
+void
+sim_list_remove_at (struct sim_ctx *ctx, int option, int list, double time)
+{
 
-  row = head[LIST_EVENT];
-  low = event_type - EPSILON;
-  high = event_type + EPSILON;
-  value = (*row).value[EVENT_TYPE];
+/* Remove a record from list "list" as list_remove does, but as of the
+   earlier time "time", so that the timest statistics for the list see its
+   length change then.  A model that works out some of its changes ahead of
+   the clock records them this way once the clock has passed them, in order
+   of time: "time" may not precede the last change to the list. */
 
-  while (((value <= low) || (value >= high)) && (row != tail[LIST_EVENT]))
-    {
-      row = (*row).sr;
-      value = (*row).value[EVENT_TYPE];
-    }
+  double now;
 
-  /* Check to see if this is the end of the event list. */
+  now = clock_back (ctx, time, list >= 0 && list <= ctx->maxlist ? ctx->list_timest[list].tlvc : time);
+  sim_list_remove (ctx, option, list);
+  ctx->sim_time = now;
+}
 
-  if (row == tail[LIST_EVENT])
-    {
+long long
+sim_event_insert_ranked (struct sim_ctx *ctx)
+{
+
+/* File transfer, with its event time and type already set, into the event
+   list in order of time, as list_file on LIST_EVENT does, and return its
+   handle as event_schedule does.  An event left in transfer by
+   event_cancel can be put back this way. */
+
+  long long handle;
+
+  ctx->list_size[LIST_EVENT]++;
+  handle = event_insert (ctx, (int) floor (ctx->transfer[EVENT_TYPE] + 0.5));
+  timest_update (ctx, &ctx->list_timest[LIST_EVENT], (double) ctx->list_size[LIST_EVENT]);
+  return handle;
+}
+
+void
+sim_list_fifo (struct sim_ctx *ctx, int list)
+{
+
+/* Declare list "list" FIFO: from now until the next sim_init, it may only be
+   filed LAST and removed FIRST, and its records are kept in a ring buffer.
+   The list must be empty. */
 
-      /* Double check to see that this is a match. */
+  struct fifo *f;
 
-      if ((value > low) && (value < high))
+  if (list < 0 || list == LIST_EVENT)
+    {
+      printf ("\nInvalid list %d for list_fifo at time %f\n", list, ctx->sim_time);
+      exit (1);
+    }
+  if (list > ctx->maxlist)
+    lists_grow (ctx, list);
+  if (ctx->list_size[list] != 0)
+    {
+      printf ("\nList %d is not empty for list_fifo at time %f\n", list, ctx->sim_time);
+      exit (1);
+    }
+  f = &ctx->fifo[list];
+  if (f->rec == NULL)
+    {
+      f->cap = FIFO_START;
+      f->rec = (double *) malloc (f->cap * ctx->value_pool.size);
+      if (f->rec == NULL)
 	{
-	  list_remove (LAST, LIST_EVENT);
-	  return 1;
+	  printf ("\nOut of memory for simlib records\n");
+	  exit (1);
 	}
-
-      else			/* no match */
-	return 0;
     }
+  f->first = 0;
+}
+
+static inline void
+fifo_file (struct sim_ctx *ctx, int option, int list)
+{
+
+/* Copy transfer to the end of FIFO list "list", whose list_size already counts
+   the new record, and zero transfer as list_file does for other lists. */
 
-  /* Check to see if this is the head of the list.  If it is at the head, then
-     it MUST be a match. */
+  struct fifo *f = &ctx->fifo[list];
+  size_t width = ctx->value_pool.size / sizeof (double);
+  int n = ctx->list_size[list] - 1, last;
 
-  if (row == head[LIST_EVENT])
+  if (option != LAST)
     {
-      list_remove (FIRST, LIST_EVENT);
-      return 1;
+      printf ("\n%d is an invalid option for list_file on FIFO list %d at time %f\n", option, list, ctx->sim_time);
+      exit (1);
     }
 
-  /* Else remove this event somewhere in the middle of the event list. */
+  /* If the ring is full, double it and move the records that had wrapped
+     around to the start of the old ring up past its end. */
+
+  if (n == f->cap)
+    {
+      f->rec = (double *) realloc (f->rec, 2 * f->cap * ctx->value_pool.size);
+      if (f->rec == NULL)
+	{
+	  printf ("\nOut of memory for simlib records\n");
+	  exit (1);
+	}
+      memcpy (f->rec + f->cap * width, f->rec, f->first * ctx->value_pool.size);
+      f->cap *= 2;
+    }
+  last = f->first + n;
+  if (last >= f->cap)
+    last -= f->cap;
+  memcpy (f->rec + last * width, ctx->transfer, ctx->value_pool.size);
+  memset (ctx->transfer, 0, ctx->value_pool.size);
+}
 
-  /* Update pointers. */
+static inline void
+fifo_remove (struct sim_ctx *ctx, int option, int list)
+{
 
-  ahead = (*row).sr;
-  behind = (*row).pr;
-  (*behind).sr = ahead;
-  (*ahead).pr = behind;
+/* Copy the first record of FIFO list "list" into transfer and drop it. */
 
-  /* Decrement the size of the event list. */
+  struct fifo *f = &ctx->fifo[list];
+  size_t width = ctx->value_pool.size / sizeof (double);
 
-  list_size[LIST_EVENT]--;
+  if (option != FIRST)
+    {
+      printf ("\n%d is an invalid option for list_remove on FIFO list %d at time %f\n", option, list, ctx->sim_time);
+      exit (1);
+    }
+  memcpy (ctx->transfer, f->rec + f->first * width, ctx->value_pool.size);
+  if (++f->first == f->cap || ctx->list_size[list] == 0)
+    f->first = 0;
+}
 
-  /* Copy and free memory. */
+static void
+fifo_free (struct sim_ctx *ctx)
+{
 
-  free ((char *) transfer);	/* Free the old transfer. */
-  transfer = (*row).value;	/* Transfer the data. */
-  free ((char *) row);		/* Free the space vacated by row. */
+/* Free the ring buffers of ctx. */
 
-  /* Update the area under the number-in-event-list curve. */
+  int list;
 
-  timest ((double) list_size[LIST_EVENT], TIM_VAR + LIST_EVENT);
-  return 1;
+  for (list = 0; list < ctx->fifo_lists; ++list)
+    free (ctx->fifo[list].rec);
+  free (ctx->fifo);
+  ctx->fifo = NULL;
+  ctx->fifo_lists = 0;
 }
 
-double
-sampst (double value, int variable)
+void
+sim_timing (struct sim_ctx *ctx)
 {
 
-/* Initialize, update, or report statistics on discrete-time processes:
-   sum/average, max (default -1E30), min (default 1E30), number of observations
-   for sampst variable "variable", where "variable":
-       = 0 initializes accumulators
-       > 0 updates sum, count, min, and max accumulators with new observation
-       < 0 reports stats on variable "variable" and returns them in transfer:
-           [1] = average of observations
-           [2] = number of observations
-           [3] = maximum of observations
-           [4] = minimum of observations */
+/* Remove next event from event list, placing its attributes in transfer.
+   Set sim_time (simulation time) to event time, transfer[1].
+   Set next_event_type to this event type, transfer[2]. */
 
-  static int ivar, num_observations[SVAR_SIZE];
-  static double max[SVAR_SIZE], min[SVAR_SIZE], sum[SVAR_SIZE];
+#ifdef SIMLIB_PROFILE
+  prof_close (ctx);
+#endif
 
-  /* If the variable value is improper, stop the simulation. */
+  /* If every variable watched has left its transient, end the warm-up. */
 
-  if (!(variable >= -MAX_SVAR) && (variable <= MAX_SVAR))
+  if (ctx->warmup_watched > 0 && ctx->warmup_pending == 0)
     {
-      printf ("\n%d is an improper value for a sampst variable at time %f\n", variable, sim_time);
-      exit (1);
+      sim_reset_stats (ctx);
+      ctx->warmup_watched = 0;
+      ctx->warmup_end = ctx->sim_time;
     }
 
-  /* Execute the desired option. */
-
-  if (variable > 0)
-    {				/* Update. */
-      sum[variable] += value;
-      if (value > max[variable])
-	max[variable] = value;
-      if (value < min[variable])
-	min[variable] = value;
-      num_observations[variable]++;
-      return 0.0;
-    }
+  /* Remove the first event from the event list and put it in transfer[]. */
 
-  if (variable < 0)
-    {				/* Report summary statistics in transfer. */
-      ivar = -variable;
-      transfer[2] = (double) num_observations[ivar];
-      transfer[3] = max[ivar];
-      transfer[4] = min[ivar];
-      if (num_observations[ivar] == 0)
-	transfer[1] = 0.0;
-      else
-	transfer[1] = sum[ivar] / transfer[2];
-      return transfer[1];
-    }
+  list_remove_as (ctx, FIRST, LIST_EVENT);
 
-  /* Initialize the accumulators. */
+  /* Check for a time reversal. */
 
-  for (ivar = 1; ivar <= MAX_SVAR; ++ivar)
+  if (ctx->transfer[EVENT_TIME] < ctx->sim_time)
     {
-      sum[ivar] = 0.0;
-      max[ivar] = -INFINITY;
-      min[ivar] = INFINITY;
-      num_observations[ivar] = 0;
+      printf ("\nAttempt to schedule event type %f for time %f at time %f\n",
+	      ctx->transfer[EVENT_TYPE], ctx->transfer[EVENT_TIME], ctx->sim_time);
+      exit (1);
     }
 
-  return 0.0;
+  /* Advance the simulation clock and set the next event type. */
+
+  ctx->sim_time = ctx->transfer[EVENT_TIME];
+  ctx->next_event_type = ctx->transfer[EVENT_TYPE];
+
+#ifdef SIMLIB_TRACE
+  if (ctx->trace != NULL)
+    trace_event (ctx);
+#endif
+
+#ifdef SIMLIB_PROFILE
+  ctx->profile->current = PROF_TYPE (ctx->next_event_type);
+  ctx->profile->type[ctx->profile->current].dispatched++;
+  clock_gettime (CLOCK_MONOTONIC, &ctx->profile->start);
+#endif
 }
 
-double
-timest (double value, int variable)
+long long
+sim_event_schedule (struct sim_ctx *ctx, double time_of_event, int type_of_event)
 {
 
-/* Initialize, update, or report statistics on continuous-time processes:
-   integral/average, max (default -1E30), min (default 1E30)
-   for timest variable "variable", where "variable":
-       = 0 initializes counters
-       > 0 updates area, min, and max accumulators with new level of variable
-       < 0 reports stats on variable "variable" and returns them in transfer:
-           [1] = time-average of variable updated to the time of this call
-           [2] = maximum value variable has attained
-           [3] = minimum value variable has attained
-   Note that variables TIM_VAR + 1 through TVAR_SIZE are used for automatic
-   record keeping on the length of lists 1 through MAX_LIST. */
+/* Schedule an event at time event_time of type event_type.  If attributes
+   beyond the first two (reserved for the event time and the event type) are
+   being used in the event list, it is the user's responsibility to place their
+   values into the transfer array before invoking event_schedule.  The value
+   returned is a handle that identifies this event to event_cancel_handle; it
+   is always positive, so 0 or a negative value may be used for "no event". */
+
+  long long handle;
+
+  ctx->transfer[EVENT_TIME] = time_of_event;
+  ctx->transfer[EVENT_TYPE] = type_of_event;
+  ctx->list_size[LIST_EVENT]++;
+  handle = event_insert (ctx, type_of_event);
+  timest_update (ctx, &ctx->list_timest[LIST_EVENT], (double) ctx->list_size[LIST_EVENT]);
+  return handle;
+}
 
-  int ivar;
-  static double area[TVAR_SIZE], max[TVAR_SIZE], min[TVAR_SIZE], preval[TVAR_SIZE], tlvc[TVAR_SIZE], treset;
+int
+sim_event_cancel (struct sim_ctx *ctx, int event_type)
+{
 
-  /* If the variable value is improper, stop the simulation. */
+/* Remove the first event of type event_type from the event list, leaving its
+   attributes in transfer.  If something is cancelled, event_cancel returns 1;
+   if no match is found, event_cancel returns 0. */
 
-  if (!(variable >= -MAX_TVAR) && (variable <= MAX_TVAR))
-    {
-      printf ("\n%d is an improper value for a timest variable at time %f\n", variable, sim_time);
-      exit (1);
-    }
+  int slot, ifound;
 
-  /* Execute the desired option. */
+  if (event_type < 0 || event_type >= ctx->type_max)
+    return 0;
 
-  if (variable > 0)
-    {				/* Update. */
-      area[variable] += (sim_time - tlvc[variable]) * preval[variable];
-      if (value > max[variable])
-	max[variable] = value;
-      if (value < min[variable])
-	min[variable] = value;
-      preval[variable] = value;
-      tlvc[variable] = sim_time;
-      return 0.0;
-    }
+  /* Look for the earliest event among the pending events of this type, ties
+     being resolved by the order in which the events were filed. */
 
-  if (variable < 0)
-    {				/* Report summary statistics in transfer. */
-      ivar = -variable;
-      area[ivar] += (sim_time - tlvc[ivar]) * preval[ivar];
-      tlvc[ivar] = sim_time;
-      transfer[1] = area[ivar] / (sim_time - treset);
-      transfer[2] = max[ivar];
-      transfer[3] = min[ivar];
-      return transfer[1];
-    }
+  ifound = -1;
+  for (slot = ctx->type_first[event_type]; slot >= 0; slot = ctx->event_slot[slot].tnext)
+    if (ifound < 0 || event_precedes (event_key (ctx, slot), event_key (ctx, ifound)))
+      ifound = slot;
 
-  /* Initialize the accumulators. */
+  /* If there is no match, return 0. */
 
-  for (ivar = 1; ivar <= MAX_TVAR; ++ivar)
-    {
-      area[ivar] = 0.0;
-      max[ivar] = -INFINITY;
-      min[ivar] = INFINITY;
-      preval[ivar] = 0.0;
-      tlvc[ivar] = sim_time;
-    }
-  treset = sim_time;
+  if (ifound < 0)
+    return 0;
 
-  return 0.0;
+  /* Remove the event, leaving its attributes in transfer. */
+
+  ctx->list_size[LIST_EVENT]--;
+#ifdef SIMLIB_PROFILE
+  ctx->profile->type[PROF_TYPE (event_type)].cancelled++;
+#endif
+  event_delete (ctx, ifound);
+
+  /* Update the area under the number-in-event-list curve. */
+
+  timest_update (ctx, &ctx->list_timest[LIST_EVENT], (double) ctx->list_size[LIST_EVENT]);
+  return 1;
 }
 
-double
-filest (int list)
+int
+sim_event_cancel_handle (struct sim_ctx *ctx, long long handle)
 {
 
-/* Report statistics on the length of list "list" in transfer:
-       [1] = time-average of list length updated to the time of this call
-       [2] = maximum length list has attained
-       [3] = minimum length list has attained
-   This uses timest variable TIM_VAR + list. */
+/* Remove the event identified by handle, as returned by event_schedule, from
+   the event list, leaving its attributes in transfer.  If the event was still
+   pending, event_cancel_handle returns 1; if it has already occurred or been
+   cancelled, event_cancel_handle returns 0. */
+
+  int slot = (int) (handle & 0xffffffff);
+
+  if (handle <= 0 || slot >= ctx->event_max || ctx->event_slot[slot].pos < 0
+      || ctx->event_slot[slot].gen != (unsigned int) (handle >> 32))
+    return 0;
 
-  return timest (0.0, -(TIM_VAR + list));
+  ctx->list_size[LIST_EVENT]--;
+#ifdef SIMLIB_PROFILE
+  ctx->profile->type[PROF_TYPE (ctx->event_slot[slot].type)].cancelled++;
+#endif
+  event_delete (ctx, slot);
+  timest_update (ctx, &ctx->list_timest[LIST_EVENT], (double) ctx->list_size[LIST_EVENT]);
+  return 1;
 }
 
-void
-out_sampst (FILE * unit, int lowvar, int highvar)
+static long long
+event_insert (struct sim_ctx *ctx, int type)
 {
 
-/* Write sampst statistics for variables lowvar through highvar on file
-   "unit". */
+/* Place transfer into the event list as an event of type "type" and return
+   its handle.  list_size[LIST_EVENT] must already count the new event. */
 
-  int ivar, iatrr;
+  int i, slot, old_max;
 
-  if (lowvar > highvar || lowvar > MAX_SVAR || highvar > MAX_SVAR)
-    return;
+  if (type < 0)
+    {
+      printf ("\n%d is an improper event type at time %f\n", type, ctx->sim_time);
+      exit (1);
+    }
+#ifdef SIMLIB_PROFILE
+  ctx->profile->type[PROF_TYPE (type)].scheduled++;
+  if (ctx->list_size[LIST_EVENT] > ctx->profile->peak[LIST_EVENT])
+    ctx->profile->peak[LIST_EVENT] = ctx->list_size[LIST_EVENT];
+#endif
 
-  fprintf (unit, "\n sampst                         Number");
+  /* Make room for the new event.  The slot table grows with the heap. */
+
+  if (ctx->list_size[LIST_EVENT] > ctx->event_max)
+    {
+      old_max = ctx->event_max;
+      ctx->event_max *= 2;
+      ctx->event_heap = (struct event_entry *) realloc (ctx->event_heap, ctx->event_max * sizeof (struct event_entry));
+      ctx->event_slot = (struct event_slot *) realloc (ctx->event_slot, ctx->event_max * sizeof (struct event_slot));
+      for (slot = ctx->event_max - 1; slot >= old_max; --slot)
+	{
+	  ctx->event_slot[slot].gen = 1;
+	  ctx->event_slot[slot].pos = -1;
+	  ctx->event_slot[slot].type = ctx->event_free;
+	  ctx->event_free = slot;
+	}
+      if (ctx->event_kind == EVLIST_CALENDAR)
+	cal_links (ctx);
+    }
+  if (type >= ctx->type_max)
+    {
+      old_max = ctx->type_max;
+      while (type >= ctx->type_max)
+	ctx->type_max *= 2;
+      ctx->type_first = (int *) realloc (ctx->type_first, ctx->type_max * sizeof (int));
+      for (i = old_max; i < ctx->type_max; ++i)
+	ctx->type_first[i] = -1;
+    }
+
+  /* Take a free slot and chain it to the other events of this type. */
+
+  slot = ctx->event_free;
+  ctx->event_free = ctx->event_slot[slot].type;
+  ctx->event_slot[slot].value = ctx->transfer;
+  ctx->event_slot[slot].type = type;
+  ctx->event_slot[slot].tprev = -1;
+  ctx->event_slot[slot].tnext = ctx->type_first[type];
+  if (ctx->type_first[type] >= 0)
+    ctx->event_slot[ctx->type_first[type]].tprev = slot;
+  ctx->type_first[type] = slot;
+
+  /* File the event in its bucket of the calendar, growing the calendar if
+     need be, or put it at the bottom of the heap and let it rise. */
+
+  i = (ctx->event_kind == EVLIST_CALENDAR) ? slot : ctx->list_size[LIST_EVENT] - 1;
+  ctx->event_heap[i].time = ctx->transfer[EVENT_TIME];
+  ctx->event_heap[i].seq = ctx->event_seq++;
+  ctx->event_heap[i].slot = slot;
+  if (ctx->event_kind == EVLIST_CALENDAR)
+    {
+      cal_insert (ctx, slot);
+      if (ctx->list_size[LIST_EVENT] > 2 * ctx->calendar->nbuckets)
+	cal_resize (ctx, 2 * ctx->calendar->nbuckets);
+    }
+  else
+    event_sift_up (ctx, i);
+
+  /* Make room for new transfer. */
+
+  ctx->transfer = value_get (ctx);
+  return (long long) (((unsigned long long) ctx->event_slot[slot].gen << 32) | (unsigned int) slot);
+}
+
+static void
+event_delete (struct sim_ctx *ctx, int slot)
+{
+
+/* Remove the event in slot "slot" from the event list and copy its
+   attributes into transfer.  list_size[LIST_EVENT] must already be
+   decremented. */
+
+  struct event_slot *s = &ctx->event_slot[slot];
+  int n = ctx->list_size[LIST_EVENT], i = s->pos;
+
+  pool_put (&ctx->value_pool, ctx->transfer);
+  ctx->transfer = s->value;
+
+  /* Unchain the slot from its type and put it on the free list. */
+
+  if (s->tprev >= 0)
+    ctx->event_slot[s->tprev].tnext = s->tnext;
+  else
+    ctx->type_first[s->type] = s->tnext;
+  if (s->tnext >= 0)
+    ctx->event_slot[s->tnext].tprev = s->tprev;
+  s->gen = s->gen < EVENT_GEN_MAX ? s->gen + 1 : 1;
+  s->pos = -1;
+  s->type = ctx->event_free;
+  ctx->event_free = slot;
+
+  /* Take the event out of its bucket, or fill its hole in the heap with the
+     last entry and restore the heap order. */
+
+  if (ctx->event_kind == EVLIST_CALENDAR)
+    {
+      cal_remove (ctx, slot, i);
+      return;
+    }
+  if (i == n)
+    return;
+  ctx->event_heap[i] = ctx->event_heap[n];
+  ctx->event_slot[ctx->event_heap[i].slot].pos = i;
+  if (i > 0 && (ctx->event_heap[i].time < ctx->event_heap[(i - 1) / 2].time
+		|| (ctx->event_heap[i].time == ctx->event_heap[(i - 1) / 2].time
+		    && ctx->event_heap[i].seq < ctx->event_heap[(i - 1) / 2].seq)))
+    event_sift_up (ctx, i);
+  else
+    event_sift_down (ctx, i);
+}
+
+static void
+event_sift_up (struct sim_ctx *ctx, int i)
+{
+  struct event_entry entry = ctx->event_heap[i];
+  int parent;
+
+  while (i > 0)
+    {
+      parent = (i - 1) / 2;
+      if (ctx->event_heap[parent].time < entry.time
+	  || (ctx->event_heap[parent].time == entry.time
+	      && ctx->event_heap[parent].seq < entry.seq))
+	break;
+      ctx->event_heap[i] = ctx->event_heap[parent];
+      ctx->event_slot[ctx->event_heap[i].slot].pos = i;
+      i = parent;
+    }
+  ctx->event_heap[i] = entry;
+  ctx->event_slot[entry.slot].pos = i;
+}
+
+static void
+event_sift_down (struct sim_ctx *ctx, int i)
+{
+  struct event_entry entry = ctx->event_heap[i];
+  int n = ctx->list_size[LIST_EVENT], child;
+
+  while ((child = 2 * i + 1) < n)
+    {
+      if (child + 1 < n
+	  && (ctx->event_heap[child + 1].time < ctx->event_heap[child].time
+	      || (ctx->event_heap[child + 1].time == ctx->event_heap[child].time
+		  && ctx->event_heap[child + 1].seq < ctx->event_heap[child].seq)))
+	++child;
+      if (entry.time < ctx->event_heap[child].time
+	  || (entry.time == ctx->event_heap[child].time
+	      && entry.seq < ctx->event_heap[child].seq))
+	break;
+      ctx->event_heap[i] = ctx->event_heap[child];
+      ctx->event_slot[ctx->event_heap[i].slot].pos = i;
+      i = child;
+    }
+  ctx->event_heap[i] = entry;
+  ctx->event_slot[entry.slot].pos = i;
+}
+
+static inline int
+event_precedes (const struct event_entry *a, const struct event_entry *b)
+{
+
+/* Return whether the event with key a comes before the one with key b. */
+
+  return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+static inline struct event_entry *
+event_key (struct sim_ctx *ctx, int slot)
+{
+
+/* Return the key of the pending event in slot "slot". */
+
+  return &ctx->event_heap[ctx->event_kind == EVLIST_CALENDAR ? slot : ctx->event_slot[slot].pos];
+}
+
+static inline int
+event_first (struct sim_ctx *ctx)
+{
+
+/* Return the slot of the earliest event.  The event list must not be
+   empty. */
+
+  return ctx->event_kind == EVLIST_CALENDAR ? cal_first (ctx) : ctx->event_heap[0].slot;
+}
+
+static int
+event_last (struct sim_ctx *ctx)
+{
+
+/* Return the slot of the latest event, which in the heap is one of the
+   leaves; the calendar has to look at every slot.  The event list must not
+   be empty, but list_size[LIST_EVENT] must already be decremented. */
+
+  int i, ilast;
+
+  if (ctx->event_kind == EVLIST_CALENDAR)
+    {
+      for (i = 0, ilast = -1; i < ctx->event_max; ++i)
+	if (ctx->event_slot[i].pos >= 0 && (ilast < 0 || event_precedes (&ctx->event_heap[ilast], &ctx->event_heap[i])))
+	  ilast = i;
+      return ilast;
+    }
+  for (i = ctx->list_size[LIST_EVENT] / 2, ilast = 0; i <= ctx->list_size[LIST_EVENT]; ++i)
+    if (event_precedes (&ctx->event_heap[ilast], &ctx->event_heap[i]))
+      ilast = i;
+  return ctx->event_heap[ilast].slot;
+}
+
+void
+sim_event_backend (struct sim_ctx *ctx, int kind)
+{
+
+/* Select the data structure behind the event list: EVLIST_HEAP (the
+   default), a binary heap, or EVLIST_CALENDAR, a calendar queue, which is
+   faster when many events are pending and they are spread fairly evenly in
+   time.  Either one dispatches the events in the same order.  The choice
+   may be made before sim_init, which keeps it, or while no event is
+   pending. */
+
+  if (kind != EVLIST_HEAP && kind != EVLIST_CALENDAR)
+    {
+      printf ("\n%d is an improper value for an event list backend\n", kind);
+      exit (1);
+    }
+  if (ctx->list_size != NULL && ctx->list_size[LIST_EVENT] > 0)
+    {
+      printf ("\nCannot change the event list backend with events pending at time %f\n", ctx->sim_time);
+      exit (1);
+    }
+  ctx->event_kind = kind;
+  cal_free (ctx);
+  if (kind == EVLIST_CALENDAR && ctx->event_heap != NULL)
+    cal_reset (ctx);
+}
+
+static void
+cal_reset (struct sim_ctx *ctx)
+{
+
+/* Set up an empty calendar for ctx, with CAL_MIN buckets a time unit wide. */
+
+  struct sim_calendar *cal;
+  int b;
+
+  cal = (struct sim_calendar *) calloc (1, sizeof (struct sim_calendar));
+  if (cal == NULL)
+    {
+      printf ("\nOut of memory for the event calendar\n");
+      exit (1);
+    }
+  ctx->calendar = cal;
+  cal->nbuckets = CAL_MIN;
+  cal->bucket = (int *) malloc (CAL_MIN * sizeof (int));
+  if (cal->bucket == NULL)
+    {
+      printf ("\nOut of memory for the event calendar\n");
+      exit (1);
+    }
+  for (b = 0; b < CAL_MIN; ++b)
+    cal->bucket[b] = -1;
+  cal->width = 1.0;
+  cal->today = 0;
+  cal_links (ctx);
+}
+
+static void
+cal_links (struct sim_ctx *ctx)
+{
+
+/* Make room for the bucket links of every slot, after the slots grew. */
+
+  struct sim_calendar *cal = ctx->calendar;
+
+  cal->next = (int *) realloc (cal->next, ctx->event_max * sizeof (int));
+  cal->prev = (int *) realloc (cal->prev, ctx->event_max * sizeof (int));
+  if (cal->next == NULL || cal->prev == NULL)
+    {
+      printf ("\nOut of memory for the event calendar\n");
+      exit (1);
+    }
+}
+
+static void
+cal_free (struct sim_ctx *ctx)
+{
+
+/* Free the calendar of ctx, if any. */
+
+  if (ctx->calendar == NULL)
+    return;
+  free (ctx->calendar->bucket);
+  free (ctx->calendar->next);
+  free (ctx->calendar->prev);
+  free (ctx->calendar);
+  ctx->calendar = NULL;
+}
+
+static inline long long
+cal_day (struct sim_calendar *cal, double time)
+{
+
+/* Return the day of "time". */
+
+  double day = time / cal->width;
+
+  return day < CAL_FAR ? (long long) day : (long long) CAL_FAR;
+}
+
+static void
+cal_insert (struct sim_ctx *ctx, int slot)
+{
+
+/* File the event in slot "slot", whose key is set, in its bucket. */
+
+  struct sim_calendar *cal = ctx->calendar;
+  struct event_entry *key = &ctx->event_heap[slot];
+  long long day = cal_day (cal, key->time);
+  int b = (int) (day & (cal->nbuckets - 1)), s, p = -1;
+
+  for (s = cal->bucket[b]; s >= 0 && event_precedes (&ctx->event_heap[s], key); s = cal->next[s])
+    p = s;
+  cal->prev[slot] = p;
+  cal->next[slot] = s;
+  if (p >= 0)
+    cal->next[p] = slot;
+  else
+    cal->bucket[b] = slot;
+  if (s >= 0)
+    cal->prev[s] = slot;
+  ctx->event_slot[slot].pos = b;
+  if (day < cal->today)
+    cal->today = day;
+}
+
+static void
+cal_remove (struct sim_ctx *ctx, int slot, int bucket)
+{
+
+/* Take the event in slot "slot" out of bucket "bucket", shrinking the
+   calendar if it has become too sparse. */
+
+  struct sim_calendar *cal = ctx->calendar;
+
+  if (cal->prev[slot] >= 0)
+    cal->next[cal->prev[slot]] = cal->next[slot];
+  else
+    cal->bucket[bucket] = cal->next[slot];
+  if (cal->next[slot] >= 0)
+    cal->prev[cal->next[slot]] = cal->prev[slot];
+  if (cal->nbuckets > CAL_MIN && ctx->list_size[LIST_EVENT] < cal->nbuckets / 2)
+    cal_resize (ctx, cal->nbuckets / 2);
+}
+
+static int
+cal_first (struct sim_ctx *ctx)
+{
+
+/* Return the slot of the earliest event, making its day the current day. */
+
+  struct sim_calendar *cal = ctx->calendar;
+  int k, s;
+
+  for (k = 0; k < cal->nbuckets; ++k, ++cal->today)
+    {
+      s = cal->bucket[cal->today & (cal->nbuckets - 1)];
+      if (s >= 0 && cal_day (cal, ctx->event_heap[s].time) <= cal->today)
+	return s;
+    }
+
+  /* A whole year without an event: the days are too short, or the events
+     are far apart.  Setting the width anew also makes the day of the
+     earliest event the current day, and that event the first in its
+     bucket. */
+
+  cal_resize (ctx, cal->nbuckets);
+  return cal->bucket[cal->today & (cal->nbuckets - 1)];
+}
+
+static void
+cal_resize (struct sim_ctx *ctx, int nbuckets)
+{
+
+/* Spread the events over "nbuckets" buckets, with the width set anew from
+   the gaps between the earliest events. */
+
+  struct sim_calendar *cal = ctx->calendar;
+  int *slots, n = 0, b, s;
+  double *times;
+
+  slots = (int *) malloc (ctx->event_max * sizeof (int));
+  times = (double *) malloc (ctx->event_max * sizeof (double));
+  if (slots == NULL || times == NULL)
+    {
+      printf ("\nOut of memory for the event calendar\n");
+      exit (1);
+    }
+  for (b = 0; b < cal->nbuckets; ++b)
+    for (s = cal->bucket[b]; s >= 0; s = cal->next[s])
+      {
+	times[n] = ctx->event_heap[s].time;
+	slots[n++] = s;
+      }
+  cal->width = cal_width (times, n, cal->width);
+
+  if (nbuckets != cal->nbuckets)
+    {
+      cal->bucket = (int *) realloc (cal->bucket, nbuckets * sizeof (int));
+      if (cal->bucket == NULL)
+	{
+	  printf ("\nOut of memory for the event calendar\n");
+	  exit (1);
+	}
+      cal->nbuckets = nbuckets;
+    }
+  for (b = 0; b < nbuckets; ++b)
+    cal->bucket[b] = -1;
+  cal->today = (n > 0) ? (long long) CAL_FAR : 0;
+  for (s = 0; s < n; ++s)
+    cal_insert (ctx, slots[s]);
+  free (slots);
+  free (times);
+}
+
+static double
+cal_width (double times[], int n, double width)
+{
+
+/* Return the width of a day for events at times[0] through [n - 1], which
+   are reordered: three times the mean gap between the CAL_SAMPLE earliest
+   events, leaving out the gaps more than twice the mean of all of them, as
+   Brown suggests.  If there are too few events, or no gaps, return "width"
+   unchanged. */
+
+  int k = (n < CAL_SAMPLE) ? n : CAL_SAMPLE, lo = 0, hi = n - 1, i, j, used;
+  double pivot, t, mean, sum;
+
+  if (k < 2)
+    return width;
+
+  /* Bring the k earliest times to the front (Hoare's selection), then sort
+     them. */
+
+  while (lo < hi)
+    {
+      pivot = times[(lo + hi) / 2];
+      for (i = lo, j = hi; i <= j;)
+	{
+	  while (times[i] < pivot)
+	    ++i;
+	  while (times[j] > pivot)
+	    --j;
+	  if (i <= j)
+	    {
+	      t = times[i];
+	      times[i++] = times[j];
+	      times[j--] = t;
+	    }
+	}
+      if (k - 1 <= j)
+	hi = j;
+      else if (k - 1 >= i)
+	lo = i;
+      else
+	break;
+    }
+  for (i = 1; i < k; ++i)
+    {
+      t = times[i];
+      for (j = i; j > 0 && times[j - 1] > t; --j)
+	times[j] = times[j - 1];
+      times[j] = t;
+    }
+
+  mean = (times[k - 1] - times[0]) / (k - 1);
+  for (i = 1, sum = 0.0, used = 0; i < k; ++i)
+    if (times[i] - times[i - 1] <= 2.0 * mean)
+      {
+	sum += times[i] - times[i - 1];
+	used++;
+      }
+  if (used == 0 || !(sum > 0.0) || !(3.0 * sum / used < CAL_FAR))
+    return width;
+  return 3.0 * sum / used;
+}
+
+static void
+cal_restore (struct sim_ctx *ctx, int n)
+{
+
+/* File in the calendar the n events whose keys a checkpoint left in
+   event_heap[0] through [n - 1], in whichever order it was written. */
+
+  struct sim_calendar *cal = ctx->calendar;
+  struct event_entry *keys;
+  double *times;
+  int nbuckets = CAL_MIN, i;
+
+  cal_links (ctx);
+  if (n == 0)
+    return;
+  keys = (struct event_entry *) malloc (n * sizeof (struct event_entry));
+  times = (double *) malloc (n * sizeof (double));
+  if (keys == NULL || times == NULL)
+    {
+      printf ("\nOut of memory for the event calendar\n");
+      exit (1);
+    }
+  memcpy (keys, ctx->event_heap, n * sizeof (struct event_entry));
+  for (i = 0; i < n; ++i)
+    times[i] = keys[i].time;
+  while (n > 2 * nbuckets)
+    nbuckets *= 2;
+  cal_resize (ctx, nbuckets);
+  cal->width = cal_width (times, n, cal->width);
+  cal->today = (long long) CAL_FAR;
+  for (i = 0; i < n; ++i)
+    ctx->event_heap[keys[i].slot] = keys[i];
+  for (i = 0; i < n; ++i)
+    cal_insert (ctx, keys[i].slot);
+  free (keys);
+  free (times);
+}
+
+static void
+pool_init (struct pool *pool, size_t size)
+{
+
+/* Empty the pool and set its block size, which must hold at least a
+   pointer. */
+
+  pool_free (pool);
+  if (size < sizeof (void *))
+    size = sizeof (void *);
+  pool->size = size;
+  pool->requests = 0;
+  pool->mallocs = 0;
+}
+
+static void *
+pool_get (struct pool *pool)
+{
+
+/* Hand out a block, preferring one from the free list. */
+
+  void *block, *chunk;
+
+  pool->requests++;
+  if (pool->free != NULL)
+    {
+      block = pool->free;
+      pool->free = *(void **) block;
+      return block;
+    }
+
+  /* Carve a new chunk if the current one is used up.  The first block of
+     every chunk links it to the previous chunk. */
+
+  if (pool->left == 0)
+    {
+      chunk = malloc ((POOL_CHUNK + 1) * pool->size);
+      if (chunk == NULL)
+	{
+	  printf ("\nOut of memory for simlib records\n");
+	  exit (1);
+	}
+      *(void **) chunk = pool->chunks;
+      pool->chunks = chunk;
+      pool->next = (char *) chunk + pool->size;
+      pool->left = POOL_CHUNK;
+      pool->mallocs++;
+    }
+  block = pool->next;
+  pool->next += pool->size;
+  pool->left--;
+  return block;
+}
+
+static void
+pool_put (struct pool *pool, void *block)
+{
+
+/* Return a block to the free list of the pool. */
+
+  *(void **) block = pool->free;
+  pool->free = block;
+}
+
+static void
+pool_free (struct pool *pool)
+{
+
+/* Release all the chunks of the pool in one step. */
+
+  void *chunk;
+
+  while (pool->chunks != NULL)
+    {
+      chunk = pool->chunks;
+      pool->chunks = *(void **) chunk;
+      free (chunk);
+    }
+  pool->free = NULL;
+  pool->next = NULL;
+  pool->left = 0;
+}
+
+static double *
+value_get (struct sim_ctx *ctx)
+{
+
+/* Get a zeroed attribute block for transfer. */
+
+  double *value;
+
+  if ((size_t) (ctx->maxatr + 1) > ctx->value_pool.size / sizeof (double))
+    {
+      printf ("\nmaxatr was raised to %d after sim_init at time %f\n", ctx->maxatr, ctx->sim_time);
+      exit (1);
+    }
+  value = (double *) pool_get (&ctx->value_pool);
+  memset (value, 0, ctx->value_pool.size);
+  return value;
+}
+
+long
+sim_pool_avoided (struct sim_ctx *ctx)
+{
+
+/* Return the number of malloc calls avoided by the record and attribute
+   pools of ctx since sim_init, i.e., the number of blocks handed out minus the
+   number of chunks allocated. */
+
+  return ctx->row_pool.requests - ctx->row_pool.mallocs + ctx->value_pool.requests - ctx->value_pool.mallocs;
+}
+
+void
+sim_release (struct sim_ctx *ctx)
+{
+
+/* Release all the memory held by context ctx and close its trace file, if
+   any.  transfer and every record still in a list become invalid; sim_init
+   must be called again before the context is used. */
+
+  sim_trace_close (ctx);
+  pool_free (&ctx->row_pool);
+  pool_free (&ctx->value_pool);
+  free (ctx->event_heap);
+  free (ctx->event_slot);
+  free (ctx->type_first);
+  cal_free (ctx);
+  free (ctx->mrg);
+  free (ctx->list_rank);
+  free (ctx->list_size);
+  free (ctx->head);
+  free (ctx->tail);
+  free (ctx->list_timest);
+  free (ctx->sampst);
+  free (ctx->timest);
+  fifo_free (ctx);
+#ifdef SIMLIB_PROFILE
+  if (ctx->profile != NULL)
+    free (ctx->profile->peak);
+  free (ctx->profile);
+  ctx->profile = NULL;
+#endif
+  ctx->event_heap = NULL;
+  ctx->event_slot = NULL;
+  ctx->type_first = NULL;
+  ctx->mrg = NULL;
+  ctx->mrg_max = 0;
+  ctx->list_rank = ctx->list_size = NULL;
+  ctx->head = ctx->tail = NULL;
+  ctx->list_timest = ctx->timest = NULL;
+  ctx->sampst = NULL;
+  ctx->num_sampst = ctx->num_timest = 0;
+  ctx->transfer = NULL;
+}
+
+double
+sim_sampst (struct sim_ctx *ctx, double value, int variable)
+{
+
+/* Initialize, update, or report statistics on discrete-time processes:
+   sum/average, max (default -1E30), min (default 1E30), number of observations
+   for sampst variable "variable", where "variable":
+       = 0 initializes accumulators
+       > 0 updates sum, count, min, and max accumulators with new observation
+       < 0 reports stats on variable "variable" and returns them in transfer:
+           [1] = average of observations
+           [2] = number of observations
+           [3] = maximum of observations
+           [4] = minimum of observations
+   A variable numbered above those used so far is added, starting with no
+   observations. */
+
+  int ivar;
+  double delta;
+  struct sampst_acc *acc;
+
+  /* Execute the desired option. */
+
+  if (variable > 0)
+    {				/* Update. */
+      acc = sampst_var (ctx, variable);
+      acc->sum += value;
+      if (value > acc->max)
+	acc->max = value;
+      if (value < acc->min)
+	acc->min = value;
+      acc->num_observations++;
+      delta = value - acc->mean;
+      acc->mean += delta / acc->num_observations;
+      acc->m2 += delta * (value - acc->mean);
+      for (ivar = 0; ivar < acc->num_quant; ++ivar)
+	p2_add (&acc->quant[ivar], value);
+      acc->batch.sum += value;
+      if (++acc->batch.count >= acc->batch.size)
+	{
+	  batch_add (ctx, &acc->batch, acc->batch.sum / acc->batch.count);
+	  acc->batch.sum = 0.0;
+	  acc->batch.count = 0;
+	}
+      return 0.0;
+    }
+
+  if (variable < 0)
+    {				/* Report summary statistics in transfer. */
+      acc = sampst_var (ctx, -variable);
+      ctx->transfer[2] = (double) acc->num_observations;
+      ctx->transfer[3] = acc->max;
+      ctx->transfer[4] = acc->min;
+      if (acc->num_observations == 0)
+	ctx->transfer[1] = 0.0;
+      else
+	ctx->transfer[1] = acc->sum / ctx->transfer[2];
+      return ctx->transfer[1];
+    }
+
+  /* Initialize the accumulators. */
+
+  for (ivar = 1; ivar <= ctx->num_sampst; ++ivar)
+    sampst_clear (&ctx->sampst[ivar]);
+
+  return 0.0;
+}
+
+static void
+sampst_clear (struct sampst_acc *acc)
+{
+
+/* Initialize the accumulators of a sampst variable, restarting the estimates
+   of its tracked quantiles.  A variable watched for the end of the warm-up
+   stays watched, its batches starting over. */
+
+  int iquant, warmup = acc->batch.warmup;
+
+  acc->sum = 0.0;
+  acc->max = -INFINITY;
+  acc->min = INFINITY;
+  acc->num_observations = 0;
+  acc->mean = 0.0;
+  acc->m2 = 0.0;
+  memset (&acc->batch, 0, sizeof (acc->batch));
+  acc->batch.size = 1.0;
+  acc->batch.warmup = warmup;
+  for (iquant = 0; iquant < acc->num_quant; ++iquant)
+    acc->quant[iquant].count = 0;
+}
+
+double
+sim_timest (struct sim_ctx *ctx, double value, int variable)
+{
+
+/* Initialize, update, or report statistics on continuous-time processes:
+   integral/average, max (default -1E30), min (default 1E30)
+   for timest variable "variable", where "variable":
+       = 0 initializes counters
+       > 0 updates area, min, and max accumulators with new level of variable
+       < 0 reports stats on variable "variable" and returns them in transfer:
+           [1] = time-average of variable updated to the time of this call
+           [2] = maximum value variable has attained
+           [3] = minimum value variable has attained
+   Variables 1 through TIM_VAR - 1 are the user's, a variable numbered above
+   those used so far being added as for sampst.  Variable TIM_VAR + list is
+   used for automatic record keeping on the length of list "list". */
+
+  int ivar;
+  struct timest_acc *acc;
+
+  /* Execute the desired option. */
+
+  if (variable > 0)
+    {				/* Update. */
+      timest_update (ctx, timest_var (ctx, variable), value);
+      return 0.0;
+    }
+
+  if (variable < 0)
+    {				/* Report summary statistics in transfer. */
+      acc = timest_var (ctx, -variable);
+      timest_advance (ctx, acc);
+      ctx->transfer[1] = acc->area / (ctx->sim_time - ctx->treset);
+      ctx->transfer[2] = acc->max;
+      ctx->transfer[3] = acc->min;
+      return ctx->transfer[1];
+    }
+
+  /* Initialize the accumulators. */
+
+  for (ivar = 1; ivar <= ctx->num_timest; ++ivar)
+    timest_clear (ctx, &ctx->timest[ivar]);
+  for (ivar = 0; ivar <= ctx->maxlist; ++ivar)
+    timest_clear (ctx, &ctx->list_timest[ivar]);
+  ctx->treset = ctx->sim_time;
+
+  return 0.0;
+}
+
+void
+sim_sampst_at (struct sim_ctx *ctx, double value, int variable, double time)
+{
+
+/* Record observation "value" of sampst variable "variable" as of the earlier
+   time "time" (see list_remove_at), which matters should the statistics be
+   reset at the end of the warm-up meanwhile. */
+
+  double now;
+
+  now = clock_back (ctx, time, ctx->treset);
+  sim_sampst (ctx, value, variable);
+  ctx->sim_time = now;
+}
+
+void
+sim_timest_at (struct sim_ctx *ctx, double value, int variable, double time)
+{
+
+/* Record that timest variable "variable" changed to level "value" at the
+   earlier time "time" (see list_remove_at), which may not precede its last
+   change. */
+
+  struct timest_acc *acc;
+  double now;
+
+  if (variable < 1)
+    {
+      printf ("\n%d is an improper variable for timest_at at time %f\n", variable, ctx->sim_time);
+      exit (1);
+    }
+  acc = timest_var (ctx, variable);
+  now = clock_back (ctx, time, acc->tlvc);
+  timest_update (ctx, acc, value);
+  ctx->sim_time = now;
+}
+
+static double
+clock_back (struct sim_ctx *ctx, double time, double last)
+{
+
+/* Set the clock back to "time" for a change dated then, and return the
+   current time to set it forward again.  "last" is the time of the latest
+   change the new one follows. */
+
+  double now = ctx->sim_time;
+
+  if (time > now || time < last)
+    {
+      printf ("\nCannot record a change at time %f, before %f or after the current time %f\n", time, last, now);
+      exit (1);
+    }
+  ctx->sim_time = time;
+  return now;
+}
+
+static inline void
+timest_update (struct sim_ctx *ctx, struct timest_acc *acc, double value)
+{
+
+/* Record that a timest variable changes to level "value" now. */
+
+  timest_advance (ctx, acc);
+  if (value > acc->max)
+    acc->max = value;
+  if (value < acc->min)
+    acc->min = value;
+  acc->preval = value;
+}
+
+static void
+timest_clear (struct sim_ctx *ctx, struct timest_acc *acc)
+{
+
+/* Initialize the accumulators of a timest variable, at level 0 from now on.
+   As with sampst_clear, a variable watched for the end of the warm-up stays
+   watched. */
+
+  int warmup = acc->batch.warmup;
+
+  acc->area = 0.0;
+  acc->max = -INFINITY;
+  acc->min = INFINITY;
+  acc->preval = 0.0;
+  acc->tlvc = ctx->sim_time;
+  acc->mean = 0.0;
+  acc->m2 = 0.0;
+  memset (&acc->batch, 0, sizeof (acc->batch));
+  acc->batch.start = ctx->sim_time;
+  acc->batch.warmup = warmup;
+}
+
+static void
+timest_restart (struct sim_ctx *ctx, struct timest_acc *acc)
+{
+
+/* Start the accumulators of a timest variable over from its current level,
+   still watched for the end of the warm-up if it was. */
+
+  int warmup = acc->batch.warmup;
+
+  acc->area = 0.0;
+  acc->max = acc->preval;
+  acc->min = acc->preval;
+  acc->tlvc = ctx->sim_time;
+  acc->mean = 0.0;
+  acc->m2 = 0.0;
+  memset (&acc->batch, 0, sizeof (acc->batch));
+  acc->batch.start = ctx->sim_time;
+  acc->batch.warmup = warmup;
+}
+
+/* Lists and statistical variables are numbered by the user, and are looked
+   up by number in arrays that grow as higher numbers come into use: the
+   accumulators of all the sampst variables, say, lie side by side in one
+   array, and a lookup is an index plus a comparison with the number
+   allocated so far.  Growing at least doubles an array, so the cost of
+   growing is amortized over the variables added, and a model pays only for
+   the lists and variables it numbers.  Growing moves the arrays, so no
+   pointer into them is kept across a call that might use a new number. */
+
+static inline struct sampst_acc *
+sampst_var (struct sim_ctx *ctx, int variable)
+{
+
+/* Return the accumulators of sampst variable "variable" (1 or more), adding
+   it if needed. */
+
+  if (variable > ctx->num_sampst)
+    sampst_grow (ctx, variable);
+  return &ctx->sampst[variable];
+}
+
+static inline struct timest_acc *
+timest_var (struct sim_ctx *ctx, int variable)
+{
+
+/* Return the accumulators of timest variable "variable" (1 or more), adding
+   it (or, for TIM_VAR + list, the list) if needed. */
+
+  if (variable >= TIM_VAR)
+    {
+      if (variable - TIM_VAR > ctx->maxlist)
+	lists_grow (ctx, variable - TIM_VAR);
+      return &ctx->list_timest[variable - TIM_VAR];
+    }
+  if (variable > ctx->num_timest)
+    timest_grow (ctx, variable);
+  return &ctx->timest[variable];
+}
+
+static void *
+grow_array (void *array, int old, int n, size_t size)
+{
+
+/* Return array, of old elements of the given size, reallocated to hold n
+   elements, the ones added being zeroed. */
+
+  array = realloc (array, n * size);
+  if (array == NULL)
+    {
+      printf ("\nOut of memory for simlib lists and variables\n");
+      exit (1);
+    }
+  memset ((char *) array + old * size, 0, (n - old) * size);
+  return array;
+}
+
+static void
+sampst_grow (struct sim_ctx *ctx, int variable)
+{
+
+/* Add sampst variables up to at least "variable", with no observations. */
+
+  int old = ctx->num_sampst, n = 2 * old, ivar;
+
+  if (n < variable)
+    n = variable;
+  ctx->sampst = (struct sampst_acc *) grow_array (ctx->sampst, old + 1, n + 1, sizeof (struct sampst_acc));
+  for (ivar = old + 1; ivar <= n; ++ivar)
+    sampst_clear (&ctx->sampst[ivar]);
+  ctx->num_sampst = n;
+}
+
+static void
+timest_grow (struct sim_ctx *ctx, int variable)
+{
+
+/* Add timest variables up to at least "variable", at level 0 from now on. */
+
+  int old = ctx->num_timest, n = 2 * old, ivar;
+
+  if (n < variable)
+    n = variable;
+  if (n >= TIM_VAR)
+    n = TIM_VAR - 1;
+  ctx->timest = (struct timest_acc *) grow_array (ctx->timest, old + 1, n + 1, sizeof (struct timest_acc));
+  for (ivar = old + 1; ivar <= n; ++ivar)
+    timest_clear (ctx, &ctx->timest[ivar]);
+  ctx->num_timest = n;
+}
+
+static void
+lists_grow (struct sim_ctx *ctx, int list)
+{
+
+/* Add lists up to at least "list", empty, unranked and not FIFO, with their
+   length statistics starting now. */
+
+  int old = ctx->maxlist + 1, n = 2 * old, i;
+
+  if (n <= list)
+    n = list + 1;
+  ctx->list_rank = (int *) grow_array (ctx->list_rank, old, n, sizeof (int));
+  ctx->list_size = (int *) grow_array (ctx->list_size, old, n, sizeof (int));
+  ctx->head = (struct master **) grow_array (ctx->head, old, n, sizeof (struct master *));
+  ctx->tail = (struct master **) grow_array (ctx->tail, old, n, sizeof (struct master *));
+  ctx->fifo = (struct fifo *) grow_array (ctx->fifo, old, n, sizeof (struct fifo));
+  ctx->list_timest = (struct timest_acc *) grow_array (ctx->list_timest, old, n, sizeof (struct timest_acc));
+#ifdef SIMLIB_PROFILE
+  ctx->profile->peak = (int *) grow_array (ctx->profile->peak, old, n, sizeof (int));
+#endif
+  for (i = old; i < n; ++i)
+    timest_clear (ctx, &ctx->list_timest[i]);
+  ctx->fifo_lists = n;
+  ctx->maxlist = n - 1;
+}
+
+double
+sim_filest (struct sim_ctx *ctx, int list)
+{
+
+/* Report statistics on the length of list "list" in transfer:
+       [1] = time-average of list length updated to the time of this call
+       [2] = maximum length list has attained
+       [3] = minimum length list has attained
+   This uses timest variable TIM_VAR + list. */
+
+  return sim_timest (ctx, 0.0, -(TIM_VAR + list));
+}
+
+void
+sim_sampst_track (struct sim_ctx *ctx, int variable, double p)
+{
+
+/* Estimate quantile p (0 < p < 1; 0.99 for the 99th percentile) of sampst
+   variable "variable" from now on, until the next sim_init.  Up to MAX_QUANT
+   quantiles may be tracked per variable; sampst (0.0, 0) restarts their
+   estimates along with the other accumulators. */
+
+  struct sampst_acc *acc;
+
+  if (variable < 1)
+    {
+      printf ("\n%d is an improper value for a sampst variable at time %f\n", variable, ctx->sim_time);
+      exit (1);
+    }
+  acc = sampst_var (ctx, variable);
+  if (!(p > 0.0 && p < 1.0) || acc->num_quant == MAX_QUANT)
+    {
+      printf ("\nCannot track quantile %f of sampst variable %d at time %f\n", p, variable, ctx->sim_time);
+      exit (1);
+    }
+  memset (&acc->quant[acc->num_quant], 0, sizeof (struct p2_quantile));
+  acc->quant[acc->num_quant++].p = p;
+}
+
+double
+sim_sampst_quantile (struct sim_ctx *ctx, int variable, double p)
+{
+
+/* Return the estimate of quantile p of sampst variable "variable", which must
+   be tracked (see sampst_track), or 0 if there are no observations. */
+
+  struct sampst_acc *acc;
+  int iquant;
+
+  if ((variable >= 1) && (variable <= ctx->num_sampst))
+    {
+      acc = &ctx->sampst[variable];
+      for (iquant = 0; iquant < acc->num_quant; ++iquant)
+	if (acc->quant[iquant].p == p)
+	  return p2_estimate (&acc->quant[iquant]);
+    }
+  printf ("\nQuantile %f of sampst variable %d is not tracked at time %f\n", p, variable, ctx->sim_time);
+  exit (1);
+}
+
+/* Quantiles are estimated with the P-square algorithm of Jain and Chlamtac
+   (Comm. ACM 28, 1985), which keeps five markers: the minimum, the p/2, p
+   and (1+p)/2 quantiles and the maximum.  Each observation moves the
+   positions of the markers above it; a marker that has drifted one position
+   or more from where it should be is moved there, its height being adjusted
+   by a piecewise-parabolic (or, failing that, linear) interpolation between
+   its neighbours.  The first five observations are kept sorted in q. */
+
+static void
+p2_add (struct p2_quantile *quant, double value)
+{
+
+/* Add an observation to the estimator. */
+
+  double *q = quant->q, *np = quant->np, p = quant->p, d, qp;
+  long *n = quant->n;
+  int i, k, ds;
+
+  if (quant->count < 5)
+    {
+      for (i = (int) quant->count; i > 0 && q[i - 1] > value; --i)
+	q[i] = q[i - 1];
+      q[i] = value;
+      if (++quant->count == 5)
+	{
+	  for (i = 0; i < 5; ++i)
+	    n[i] = i;
+	  np[0] = 0.0;
+	  np[1] = 2.0 * p;
+	  np[2] = 4.0 * p;
+	  np[3] = 2.0 + 2.0 * p;
+	  np[4] = 4.0;
+	}
+      return;
+    }
+  quant->count++;
+
+  /* Find the cell k of the observation, stretching the extremes if needed. */
+
+  if (value < q[0])
+    {
+      q[0] = value;
+      k = 0;
+    }
+  else if (value >= q[4])
+    {
+      q[4] = value;
+      k = 3;
+    }
+  else
+    for (k = 0; value >= q[k + 1]; ++k)
+      ;
+
+  /* Shift the positions of the markers above the cell and the desired
+     positions of all markers. */
+
+  for (i = k + 1; i < 5; ++i)
+    n[i]++;
+  np[1] += p / 2.0;
+  np[2] += p;
+  np[3] += (1.0 + p) / 2.0;
+  np[4] += 1.0;
+
+  /* Adjust the middle markers. */
+
+  for (i = 1; i <= 3; ++i)
+    {
+      d = np[i] - n[i];
+      if ((d >= 1.0 && n[i + 1] - n[i] > 1) || (d <= -1.0 && n[i - 1] - n[i] < -1))
+	{
+	  ds = d > 0.0 ? 1 : -1;
+	  qp = q[i] + (double) ds / (n[i + 1] - n[i - 1])
+	    * ((n[i] - n[i - 1] + ds) * (q[i + 1] - q[i]) / (n[i + 1] - n[i])
+	       + (n[i + 1] - n[i] - ds) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+	  if (!(q[i - 1] < qp && qp < q[i + 1]))
+	    qp = q[i] + ds * (q[i + ds] - q[i]) / (n[i + ds] - n[i]);
+	  q[i] = qp;
+	  n[i] += ds;
+	}
+    }
+}
+
+static double
+p2_estimate (struct p2_quantile *quant)
+{
+
+/* Return the current estimate: the middle marker, or while there are fewer
+   than five observations, the nearest-rank quantile of those there are. */
+
+  int rank;
+
+  if (quant->count == 0)
+    return 0.0;
+  if (quant->count >= 5)
+    return quant->q[2];
+  rank = (int) ceil (quant->p * quant->count) - 1;
+  return quant->q[rank < 0 ? 0 : rank];
+}
+
+static void
+timest_advance (struct sim_ctx *ctx, struct timest_acc *acc)
+{
+
+/* Bring the accumulators of a timest variable up to the current time, the
+   variable having stayed at level preval since tlvc.  The time-weighted mean
+   and sum of squared deviations are updated as in Welford's method, with the
+   time since the last reset as the total weight.  The batches are consecutive
+   stretches of batch.size time units from the last reset; the first batch
+   size is taken to be the first nonzero stretch of time seen. */
+
+  struct batch_means *batch = &acc->batch;
+  double from = acc->tlvc, to = ctx->sim_time, end, delta;
+
+  acc->area += (ctx->sim_time - acc->tlvc) * acc->preval;
+  acc->tlvc = ctx->sim_time;
+  if (to <= from)
+    return;
+
+  delta = acc->preval - acc->mean;
+  acc->mean += delta * (to - from) / (to - ctx->treset);
+  acc->m2 += (to - from) * delta * (acc->preval - acc->mean);
+
+  if (batch->size == 0.0)
+    batch->size = to - from;
+  for (;;)
+    {
+      end = batch->start + batch->size;
+      if (to < end)
+	{
+	  batch->sum += (to - from) * acc->preval;
+	  return;
+	}
+      batch->sum += (end - from) * acc->preval;
+      batch->start = end;
+      from = end;
+      batch_add (ctx, batch, batch->sum / batch->size);
+      batch->sum = 0.0;
+    }
+}
+
+static void
+batch_add (struct sim_ctx *ctx, struct batch_means *batch, double mean)
+{
+
+/* Append the mean of a completed batch.  When MAX_BATCH batches are complete,
+   merge them pairwise into MAX_BATCH / 2 batches of twice the size, so that
+   the number of batches stays between MAX_BATCH / 2 and MAX_BATCH once the
+   batch size starts doubling.  If the variable is watched for the end of the
+   warm-up, look for it. */
+
+  int i;
+
+  batch->mean[batch->num++] = mean;
+  if (batch->num == MAX_BATCH)
+    {
+      for (i = 0; i < MAX_BATCH / 2; ++i)
+	batch->mean[i] = 0.5 * (batch->mean[2 * i] + batch->mean[2 * i + 1]);
+      batch->num = MAX_BATCH / 2;
+      batch->size *= 2.0;
+      batch->merges++;
+    }
+  if (batch->warmup && batch->merges >= MSER_MERGES && mser_truncation (batch) < batch->num / 2)
+    {
+      batch->warmup = 0;
+      ctx->warmup_pending--;
+    }
+}
+
+static double
+batch_half_width (struct batch_means *batch)
+{
+
+/* Return the half-width of a 95% confidence interval for the mean from the
+   completed batches, or 0 if there are fewer than two of them. */
+
+  int i, n = batch->num;
+  double mean = 0.0, var = 0.0;
+
+  if (n < 2)
+    return 0.0;
+  for (i = 0; i < n; ++i)
+    mean += batch->mean[i];
+  mean /= n;
+  for (i = 0; i < n; ++i)
+    var += (batch->mean[i] - mean) * (batch->mean[i] - mean);
+  var /= n - 1;
+  return student_t95 (n - 1) * sqrt (var / n);
+}
+
+/* The end of the warm-up is detected with the MSER rule (White, 1997) applied
+   to the batch means of the watched variables: for a series of k batch means,
+   the truncation point d* is the d, up to k / 2, that minimizes the variance
+   of the means d + 1 through k divided by (k - d), i.e., the squared standard
+   error of their average.  Once the batches hold 2^MSER_MERGES observations
+   (for timest, base stretches of time) or more, every completed batch
+   brings a new test; a variable has left its transient when d* falls short
+   of k / 2, as MSER only trusts a truncation point in the first half of the
+   series.  When all watched variables have left it, the next call of
+   timing resets all the statistics with reset_stats and warmup_end tells
+   when.  The point d* itself lies in the past and cannot be reset to, so the
+   reset comes somewhat later than strictly needed, which costs data but not
+   bias. */
+
+static int
+mser_truncation (struct batch_means *batch)
+{
+
+/* Return the MSER truncation point of the batch means: the number of leading
+   batches to drop. */
+
+  int k = batch->num, d, dbest = 0;
+  double sum = 0.0, sumsq = 0.0, mser, best = 0.0;
+
+  /* Go backwards from the last batch, so that sum and sumsq always hold the
+     sums over batches d through k - 1. */
+
+  for (d = k - 1; d >= 0; --d)
+    {
+      sum += batch->mean[d];
+      sumsq += batch->mean[d] * batch->mean[d];
+      if (d > k / 2)
+	continue;
+      mser = (sumsq - sum * sum / (k - d)) / ((double) (k - d) * (k - d));
+      if (d == k / 2 || mser <= best)
+	{
+	  best = mser;
+	  dbest = d;
+	}
+    }
+  return dbest;
+}
+
+void
+sim_reset_stats (struct sim_ctx *ctx)
+{
+
+/* Discard the statistics gathered so far, as at the end of a warm-up: the
+   sampst accumulators are initialized as by sampst (0.0, 0), and the timest
+   accumulators start over from the current level of each variable, which,
+   unlike timest (0.0, 0), keeps the lengths of the lists right. */
+
+  int ivar;
+
+  sim_sampst (ctx, 0.0, 0);
+  for (ivar = 1; ivar <= ctx->num_timest; ++ivar)
+    timest_restart (ctx, &ctx->timest[ivar]);
+  for (ivar = 0; ivar <= ctx->maxlist; ++ivar)
+    timest_restart (ctx, &ctx->list_timest[ivar]);
+  ctx->treset = ctx->sim_time;
+}
+
+void
+sim_warmup_sampst (struct sim_ctx *ctx, int variable)
+{
+
+/* Watch sampst variable "variable" for the end of the warm-up. */
+
+  struct sampst_acc *acc;
+
+  if (variable < 1)
+    {
+      printf ("\n%d is an improper value for a sampst variable at time %f\n", variable, ctx->sim_time);
+      exit (1);
+    }
+  acc = sampst_var (ctx, variable);
+  if (!acc->batch.warmup)
+    {
+      acc->batch.warmup = 1;
+      ctx->warmup_watched++;
+      ctx->warmup_pending++;
+    }
+}
+
+void
+sim_warmup_timest (struct sim_ctx *ctx, int variable)
+{
+
+/* Watch timest variable "variable" for the end of the warm-up. */
+
+  struct timest_acc *acc;
+
+  if (variable < 1)
+    {
+      printf ("\n%d is an improper value for a timest variable at time %f\n", variable, ctx->sim_time);
+      exit (1);
+    }
+  acc = timest_var (ctx, variable);
+  if (!acc->batch.warmup)
+    {
+      acc->batch.warmup = 1;
+      ctx->warmup_watched++;
+      ctx->warmup_pending++;
+    }
+}
+
+void
+sim_warmup_filest (struct sim_ctx *ctx, int list)
+{
+
+/* Watch the length of list "list" for the end of the warm-up. */
+
+  sim_warmup_timest (ctx, TIM_VAR + list);
+}
+
+double
+sim_warmup_end (struct sim_ctx *ctx)
+{
+
+/* Return the time at which the statistics were reset at the end of the
+   warm-up, or -1 if that has not happened (yet). */
+
+  return ctx->warmup_end;
+}
+
+double
+sim_sampst_ci (struct sim_ctx *ctx, int variable)
+{
+
+/* Report the precision of the average of sampst variable "variable" in
+   transfer, and return the half-width [2]:
+       [1] = average of observations
+       [2] = half-width of a 95% confidence interval for the mean, from
+             non-overlapping batch means (0 if there are fewer than 2)
+       [3] = standard deviation of observations
+       [4] = number of batch means the interval rests on
+   The batch size starts at 1 and doubles whenever MAX_BATCH batches are
+   complete; observations in the current, incomplete batch are left out of
+   the interval.  The batch means must be roughly independent for the
+   interval to be valid, i.e., the batches must be long compared to the
+   correlation of the observations. */
+
+  struct sampst_acc *acc;
+
+  if (variable < 1)
+    {
+      printf ("\n%d is an improper value for a sampst variable at time %f\n", variable, ctx->sim_time);
+      exit (1);
+    }
+  acc = sampst_var (ctx, variable);
+  ctx->transfer[1] = acc->num_observations > 0 ? acc->sum / acc->num_observations : 0.0;
+  ctx->transfer[2] = batch_half_width (&acc->batch);
+  ctx->transfer[3] = acc->num_observations > 1 ? sqrt (acc->m2 / (acc->num_observations - 1)) : 0.0;
+  ctx->transfer[4] = (double) acc->batch.num;
+  return ctx->transfer[2];
+}
+
+double
+sim_timest_ci (struct sim_ctx *ctx, int variable)
+{
+
+/* Report the precision of the time-average of timest variable "variable",
+   updated to the time of this call, in transfer, and return the half-width
+   [2]:
+       [1] = time-average of variable
+       [2] = half-width of a 95% confidence interval for the time-average,
+             from non-overlapping batch means (0 if there are fewer than 2)
+       [3] = time-weighted standard deviation of variable
+       [4] = number of batch means the interval rests on
+   The batches are stretches of time, as described in timest_advance, whose
+   length doubles whenever MAX_BATCH batches are complete. */
+
+  struct timest_acc *acc;
+
+  if (variable < 1)
+    {
+      printf ("\n%d is an improper value for a timest variable at time %f\n", variable, ctx->sim_time);
+      exit (1);
+    }
+  acc = timest_var (ctx, variable);
+  timest_advance (ctx, acc);
+  ctx->transfer[1] = acc->area / (ctx->sim_time - ctx->treset);
+  ctx->transfer[2] = batch_half_width (&acc->batch);
+  ctx->transfer[3] = ctx->sim_time > ctx->treset ? sqrt (acc->m2 / (ctx->sim_time - ctx->treset)) : 0.0;
+  ctx->transfer[4] = (double) acc->batch.num;
+  return ctx->transfer[2];
+}
+
+double
+sim_filest_ci (struct sim_ctx *ctx, int list)
+{
+
+/* Report the precision of the time-average length of list "list" in
+   transfer, as timest_ci does for timest variable TIM_VAR + list. */
+
+  return sim_timest_ci (ctx, TIM_VAR + list);
+}
+
+void
+sim_out_sampst (struct sim_ctx *ctx, FILE * unit, int lowvar, int highvar)
+{
+
+/* Write sampst statistics for variables lowvar through highvar on file
+   "unit", each variable followed by the estimates of its tracked quantiles
+   (p90 being the 90th percentile, and so on). */
+
+  int ivar, iatrr, iquant;
+  char label[32];
+  struct sampst_acc *acc;
+
+  if (lowvar > highvar || lowvar < 1)
+    return;
+
+  fprintf (unit, "\n sampst                         Number");
   fprintf (unit, "\nvariable                          of");
   fprintf (unit, "\n number       Average           values          Maximum");
   fprintf (unit, "          Minimum");
   fprintf (unit, "\n___________________________________");
   fprintf (unit, "_____________________________________");
-  for (ivar = lowvar; ivar <= highvar; ++ivar)
+  for (ivar = lowvar; ivar <= highvar; ++ivar)
+    {
+      fprintf (unit, "\n\n%5d", ivar);
+      sim_sampst (ctx, 0.00, -ivar);
+      for (iatrr = 1; iatrr <= 4; ++iatrr)
+	pprint_out (ctx, unit, iatrr);
+      acc = &ctx->sampst[ivar];
+      for (iquant = 0; iquant < acc->num_quant; ++iquant)
+	{
+	  snprintf (label, sizeof (label), "p%g", 100.0 * acc->quant[iquant].p);
+	  fprintf (unit, "\n%5s %#15.6G ", label, p2_estimate (&acc->quant[iquant]));
+	}
+    }
+  fprintf (unit, "\n___________________________________");
+  fprintf (unit, "_____________________________________\n\n\n");
+}
+
+void
+sim_out_timest (struct sim_ctx *ctx, FILE * unit, int lowvar, int highvar)
+{
+
+/* Write timest statistics for variables lowvar through highvar on file
+   "unit". */
+
+  int ivar, iatrr;
+
+  if (lowvar > highvar || lowvar < 1 || highvar >= TIM_VAR)
+    return;
+
+
+  fprintf (unit, "\n  timest");
+  fprintf (unit, "\n variable       Time");
+  fprintf (unit, "\n  number       average          Maximum          Minimum");
+  fprintf (unit, "\n________________________________________________________");
+  for (ivar = lowvar; ivar <= highvar; ++ivar)
+    {
+      fprintf (unit, "\n\n%5d", ivar);
+      sim_timest (ctx, 0.00, -ivar);
+      for (iatrr = 1; iatrr <= 3; ++iatrr)
+	pprint_out (ctx, unit, iatrr);
+    }
+  fprintf (unit, "\n________________________________________________________");
+  fprintf (unit, "\n\n\n");
+}
+
+void
+sim_out_filest (struct sim_ctx *ctx, FILE * unit, int lowlist, int highlist)
+{
+
+/* Write timest list-length statistics for lists lowlist through highlist on
+   file "unit". */
+
+  int list, iatrr;
+
+  if (lowlist > highlist || lowlist < 0)
+    return;
+
+  fprintf (unit, "\n  File         Time");
+  fprintf (unit, "\n number       average          Maximum          Minimum");
+  fprintf (unit, "\n_______________________________________________________");
+  for (list = lowlist; list <= highlist; ++list)
+    {
+      fprintf (unit, "\n\n%5d", list);
+      sim_filest (ctx, list);
+      for (iatrr = 1; iatrr <= 3; ++iatrr)
+	pprint_out (ctx, unit, iatrr);
+    }
+  fprintf (unit, "\n_______________________________________________________");
+  fprintf (unit, "\n\n\n");
+}
+
+static void
+pprint_out (struct sim_ctx *ctx, FILE * unit, int i)	/* Write ith entry in transfer to file
+				   "unit". */
+{
+  if (ctx->transfer[i] == -1e30 || ctx->transfer[i] == 1e30)
+    fprintf (unit, " %#15.6G ", 0.00);
+  else
+    fprintf (unit, " %#15.6G ", ctx->transfer[i]);
+}
+
+#ifdef SIMLIB_PROFILE
+
+static void
+prof_close (struct sim_ctx *ctx)
+{
+
+/* Charge the time since the last dispatch to the event being handled. */
+
+  struct sim_profile *prof = ctx->profile;
+  struct timespec now;
+  long long ns;
+  int bucket;
+
+  if (prof->current < 0)
+    return;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  ns = (now.tv_sec - prof->start.tv_sec) * 1000000000LL + (now.tv_nsec - prof->start.tv_nsec);
+  prof->type[prof->current].seconds += ns * 1e-9;
+  for (bucket = 0; ns > 1 && bucket < PROF_BUCKETS - 1; ns >>= 1)
+    ++bucket;
+  prof->type[prof->current].hist[bucket]++;
+  prof->current = -1;
+}
+
+void
+sim_out_profile (struct sim_ctx *ctx, FILE * unit)
+{
+
+/* Write the profile of ctx on file "unit": the counts and handler times of
+   every event type seen, the histogram of the handler times, the peak length
+   of every list used, and the allocations avoided by the record pools (see
+   pool_avoided).  The event being handled is charged first. */
+
+  struct sim_profile *prof = ctx->profile;
+  struct prof_type *t;
+  int type, bucket, list;
+
+  prof_close (ctx);
+  fprintf (unit, "\n  Event                                         Handler     Mean handler");
+  fprintf (unit, "\n   type   Scheduled   Cancelled  Dispatched     time (s)       time (ns)");
+  fprintf (unit, "\n___________________________________");
+  fprintf (unit, "_____________________________________");
+  for (type = 0; type < PROF_TYPES; ++type)
+    {
+      t = &prof->type[type];
+      if (t->scheduled == 0 && t->dispatched == 0)
+	continue;
+      fprintf (unit, "\n\n%5d%s%12ld%12ld%12ld%13.6f%16.1f", type, type == PROF_TYPES - 1 ? "+" : " ",
+	       t->scheduled, t->cancelled, t->dispatched, t->seconds,
+	       t->dispatched > 0 ? t->seconds * 1e9 / t->dispatched : 0.0);
+    }
+  fprintf (unit, "\n___________________________________");
+  fprintf (unit, "_____________________________________\n\n");
+
+  fprintf (unit, "\nHandler time histogram (dispatches per range of nanoseconds)\n");
+  for (type = 0; type < PROF_TYPES; ++type)
+    {
+      t = &prof->type[type];
+      if (t->dispatched == 0)
+	continue;
+      fprintf (unit, "\n%5d%s", type, type == PROF_TYPES - 1 ? "+" : " ");
+      for (bucket = 0; bucket < PROF_BUCKETS; ++bucket)
+	if (t->hist[bucket] > 0)
+	  fprintf (unit, "  [%lld,%lld) %ld", bucket == 0 ? 0LL : 1LL << bucket, 1LL << (bucket + 1), t->hist[bucket]);
+    }
+
+  fprintf (unit, "\n\n\n List   Peak length");
+  fprintf (unit, "\n__________________");
+  for (list = 0; list < ctx->fifo_lists; ++list)
+    if (prof->peak[list] > 0)
+      fprintf (unit, "\n%5d%14d", list, prof->peak[list]);
+  fprintf (unit, "\n__________________\n\n\n");
+  fprintf (unit, "Allocations avoided by the record pools: %ld\n\n\n", sim_pool_avoided (ctx));
+}
+
+#else
+
+void
+sim_out_profile (struct sim_ctx *ctx, FILE * unit)
+{
+
+/* There is no profile to write. */
+
+  (void) ctx;
+  (void) unit;
+}
+
+#endif
+
+#ifdef SIMLIB_TRACE
+
+static int
+trace_chunk (struct sim_trace *tr)
+{
+
+/* Add a chunk of records to the end of trace file tr and map it in place of
+   the last one.  Return 0 if it cannot be allocated or mapped. */
+
+  long page = sysconf (_SC_PAGESIZE);
+  off_t first = (off_t) TRACE_BYTES (tr, tr->end), from = first - first % page;
+
+  if (tr->map != NULL)
+    munmap (tr->map, tr->map_bytes);
+  tr->map = NULL;
+  if (posix_fallocate (tr->fd, first, (off_t) (tr->records * tr->record_size)) != 0)
+    return 0;
+  tr->map_bytes = (size_t) (TRACE_BYTES (tr, tr->end + tr->records) - from);
+  tr->map = mmap (NULL, tr->map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, tr->fd, from);
+  if (tr->map == MAP_FAILED)
+    {
+      tr->map = NULL;
+      return 0;
+    }
+  tr->chunk = (char *) tr->map + (first - from) - tr->end * tr->record_size;
+  tr->end += tr->records;
+  return 1;
+}
+
+int
+sim_trace_open (struct sim_ctx *ctx, const char *path, long long records, int lists)
+{
+
+/* Start recording the events dispatched in ctx to trace file "path", grown
+   "records" records at a time (TRACE_CHUNK if records < 1), with the lengths
+   of lists 1 through "lists" (0 to TRACE_LISTS) in each record, closing any
+   trace file being recorded.  Return 0 if the file cannot be created. */
+
+  struct sim_trace *tr;
+  void *header = MAP_FAILED;
+
+  sim_trace_close (ctx);
+  tr = (struct sim_trace *) malloc (sizeof (struct sim_trace));
+  tr->records = records < 1 ? TRACE_CHUNK : records;
+  tr->lists = lists < 0 ? 0 : lists > TRACE_LISTS ? TRACE_LISTS : lists;
+  tr->record_size = TRACE_RECORD_SIZE (tr->lists);
+  tr->end = 0;
+  tr->map = NULL;
+  tr->fd = open (path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (tr->fd < 0 || !trace_chunk (tr)
+      || (header = mmap (NULL, sizeof (struct trace_header), PROT_READ | PROT_WRITE, MAP_SHARED, tr->fd, 0)) == MAP_FAILED)
+    {
+      if (tr->map != NULL)
+	munmap (tr->map, tr->map_bytes);
+      if (tr->fd >= 0)
+	close (tr->fd);
+      free (tr);
+      return 0;
+    }
+  tr->header = (struct trace_header *) header;
+  memcpy (tr->header->magic, "SIMTRACE", 8);
+  tr->header->record_size = (int) tr->record_size;
+  tr->header->lists = tr->lists;
+  tr->header->count = 0;
+  ctx->trace = tr;
+  return 1;
+}
+
+static void
+trace_drop (struct sim_ctx *ctx)
+{
+
+/* Unmap and close the trace file of ctx and stop recording it. */
+
+  struct sim_trace *tr = ctx->trace;
+
+  if (tr->map != NULL)
+    munmap (tr->map, tr->map_bytes);
+  munmap (tr->header, sizeof (struct trace_header));
+  close (tr->fd);
+  free (tr);
+  ctx->trace = NULL;
+}
+
+void
+sim_trace_close (struct sim_ctx *ctx)
+{
+
+/* Stop recording the trace of ctx, if any, and cut the file to the records
+   written. */
+
+  long long count;
+
+  if (ctx->trace == NULL)
+    return;
+  count = ctx->trace->header->count;
+  if (ftruncate (ctx->trace->fd, (off_t) TRACE_BYTES (ctx->trace, count)) != 0)
+    printf ("\nCould not trim the trace file to %lld records\n", count);
+  trace_drop (ctx);
+}
+
+static void
+trace_event (struct sim_ctx *ctx)
+{
+
+/* Append the event just removed by timing to the trace file of ctx, adding
+   a chunk to the file first if it is full.  If it cannot grow, the trace
+   ends there. */
+
+  struct sim_trace *tr = ctx->trace;
+  struct trace_record *rec;
+  int list, length;
+
+  if (tr->header->count == tr->end && !trace_chunk (tr))
+    {
+      printf ("\nCould not grow the trace file past %lld records; tracing stopped\n", tr->end);
+      trace_drop (ctx);
+      return;
+    }
+  rec = (struct trace_record *) (tr->chunk + tr->header->count * tr->record_size);
+  rec->time = ctx->sim_time;
+  rec->attr[0] = (float) ctx->transfer[3];
+  rec->attr[1] = (float) ctx->transfer[4];
+  rec->type = (short) ctx->next_event_type;
+  length = ctx->list_size[LIST_EVENT];
+  rec->events = (unsigned short) (length < TRACE_LENGTH_MAX ? length : TRACE_LENGTH_MAX);
+  for (list = 1; list <= tr->lists; ++list)
+    {
+      length = list <= ctx->maxlist ? ctx->list_size[list] : 0;
+      rec->length[list - 1] = (unsigned short) (length < TRACE_LENGTH_MAX ? length : TRACE_LENGTH_MAX);
+    }
+  tr->header->count++;
+}
+
+#else
+
+int
+sim_trace_open (struct sim_ctx *ctx, const char *path, long long records, int lists)
+{
+
+/* There is no trace recorder. */
+
+  (void) ctx;
+  (void) path;
+  (void) records;
+  (void) lists;
+  return 0;
+}
+
+void
+sim_trace_close (struct sim_ctx *ctx)
+{
+
+/* There is no trace to close. */
+
+  (void) ctx;
+}
+
+#endif
+
+double
+sim_expon (struct sim_ctx *ctx, double mean, int stream)	/* Exponential variate generation
+				   function. */
+{
+  return -mean * log (urand (ctx, stream));
+
+}
+
+int
+sim_random_integer (struct sim_ctx *ctx, double prob_distrib[], int stream)	/* Discrete-variate
+							   generation function. */
+{
+  int i;
+  double u;
+
+  u = urand (ctx, stream);
+
+  for (i = 1; u >= prob_distrib[i]; ++i)
+    ;
+  return i;
+}
+
+void
+alias_setup (struct alias_table *table, const double prob[], int n)
+{
+
+/* Build the alias table of the distribution giving outcome i, 1 <= i <= n,
+   probability prob[i] (the probabilities are normalized to sum to 1), for
+   random_alias.  Each of the n equal columns holds one outcome and, on top
+   of it, the alias that fills the column up; Vose's method pairs every
+   outcome short of 1 / n with one in excess. */
+
+  double scaled[MAX_ALIAS + 1], sum = 0.0;
+  int small[MAX_ALIAS], large[MAX_ALIAS], num_small = 0, num_large = 0, i, s, l;
+
+  if (n < 1 || n > MAX_ALIAS)
+    {
+      printf ("\n%d is an improper number of outcomes for an alias table\n", n);
+      exit (1);
+    }
+  for (i = 1; i <= n; ++i)
+    sum += prob[i];
+  table->n = n;
+  for (i = 1; i <= n; ++i)
+    {
+      scaled[i] = prob[i] * n / sum;
+      if (scaled[i] < 1.0)
+	small[num_small++] = i;
+      else
+	large[num_large++] = i;
+    }
+  while (num_small > 0 && num_large > 0)
+    {
+      s = small[--num_small];
+      l = large[num_large - 1];
+      table->cut[s] = 1.0 - scaled[s];
+      table->alias[s] = l;
+      scaled[l] -= 1.0 - scaled[s];
+      if (scaled[l] < 1.0)
+	{
+	  num_large--;
+	  small[num_small++] = l;
+	}
+    }
+
+  /* What is left fills its column, up to rounding. */
+
+  while (num_large > 0)
+    {
+      l = large[--num_large];
+      table->cut[l] = 0.0;
+      table->alias[l] = l;
+    }
+  while (num_small > 0)
+    {
+      s = small[--num_small];
+      table->cut[s] = 0.0;
+      table->alias[s] = s;
+    }
+}
+
+int
+sim_random_alias (struct sim_ctx *ctx, const struct alias_table *table, int stream)
+{
+
+/* Generate an outcome of the distribution of alias table "table" in O(1)
+   time: a single random number picks a column and the place in it.  A
+   distribution with one outcome takes no random number. */
+
+  double x;
+  int column;
+
+  if (table->n == 1)
+    return 1;
+  x = urand (ctx, stream) * table->n;
+  column = (int) x;
+  return (x - column >= table->cut[column + 1]) ? column + 1 : table->alias[column + 1];
+}
+
+double
+sim_uniform (struct sim_ctx *ctx, double a, double b, int stream)	/* Uniform variate generation
+						   function. */
+{
+  return a + urand (ctx, stream) * (b - a);
+}
+
+double
+sim_erlang (struct sim_ctx *ctx, int m, double mean, int stream)	/* Erlang variate generation
+					   function. */
+{
+  int i;
+  double mean_exponential, sum;
+
+  mean_exponential = mean / m;
+  sum = 0.0;
+  for (i = 1; i <= m; ++i)
+    sum += sim_expon (ctx, mean_exponential, stream);
+  return sum;
+}
+
+/* Prime modulus multiplicative linear congruential generator
+
+   Z[i] = (630360016 * Z[i-1]) (mod(pow(2,31) - 1)), based on Marse and
+   Roberts' portable FORTRAN random-number generator UNIRAN.  Multiple
+   (100) streams are supported, with seeds spaced 100,000 apart.
+   Throughout, input argument "stream" must be an int giving the
+   desired stream number.  The header file lcgrand.h must be included in
+   the calling program (#include "lcgrand.h") before using these
+   functions.  The state of the streams is part of the simulation context,
+   so every context draws its own copy of the 100 streams.
+
+   Usage:
+
+   1. To obtain the next U(0,1) random number from stream "stream,"
+      execute
+          u = lcgrand(stream);
+      where lcgrand is a double function.  The double variable u will
+      contain the next random number.
+
+   2. To set the seed for stream "stream" to a desired value zset,
+      execute
+          lcgrandst(zset, stream);
+      where lcgrandst is a void function and zset must be a long set to
+      the desired seed, a number between 1 and 2147483646 (inclusive).
+      Default seeds for all 100 streams are given in the code.
+
+   3. To get the current (most recently used) integer in the sequence
+      being generated for stream "stream" into the long variable zget,
+      execute
+          zget = lcgrandgt(stream);
+      where lcgrandgt is a long function.
+
+   The default seeds are 100,000 values apart along one cycle of the
+   generator, and lcgrandvs extends them to further "virtual" streams with
+   the same spacing, which is how independent replications get seed sets
+   that do not overlap:
+
+   4. To set stream "stream" to the start of virtual stream vstream,
+      execute
+          lcgrandvs(vstream, stream);
+      where vstream is a long between 1 and MAX_VSTREAM.  Virtual streams
+      1 through 100 start at the default seeds of streams 1 through 100.
+
+   5. To place the next n U(0,1) random numbers from stream "stream" in
+      the double array u, execute
+          lcgrand_fill(stream, u, n);
+      where lcgrand_fill is a void function.  u receives exactly the
+      numbers n calls of lcgrand would return; expon_fill and
+      uniform_fill deliver expon and uniform variates the same way. */
+
+/* Define the constants. */
+
+#define MODLUS 2147483647
+#define MULT1       24112
+#define MULT2       26143
+#define MULT    630360016	/* MULT1 * MULT2 mod MODLUS. */
+#define LCG_BLOCK     256	/* Numbers generated at a time by lcgrand_fill. */
+#define VSTREAM_SPACING 100000	/* Spacing of the (virtual) streams. */
+
+/* Set the default seeds for all 100 streams.  Every context starts out with
+   these seeds. */
+
+#define ZRNG_SEEDS 1, \
+  1973272912, 281629770, 20006270, 1280689831, 2096730329, 1933576050, \
+  913566091, 246780520, 1363774876, 604901985, 1511192140, 1259851944, \
+  824064364, 150493284, 242708531, 75253171, 1964472944, 1202299975, \
+  233217322, 1911216000, 726370533, 403498145, 993232223, 1103205531, \
+  762430696, 1922803170, 1385516923, 76271663, 413682397, 726466604, \
+  336157058, 1432650381, 1120463904, 595778810, 877722890, 1046574445, \
+  68911991, 2088367019, 748545416, 622401386, 2122378830, 640690903, \
+  1774806513, 2132545692, 2079249579, 78130110, 852776735, 1187867272, \
+  1351423507, 1645973084, 1997049139, 922510944, 2045512870, 898585771, \
+  243649545, 1004818771, 773686062, 403188473, 372279877, 1901633463, \
+  498067494, 2087759558, 493157915, 597104727, 1530940798, 1814496276, \
+  536444882, 1663153658, 855503735, 67784357, 1432404475, 619691088, \
+  119025595, 880802310, 176192644, 1116780070, 277854671, 1366580350, \
+  1142483975, 2026948561, 1053920743, 786262391, 1792203830, 1494667770, \
+  1923011392, 1433700034, 1244184613, 1147297105, 539712780, 1545929719, \
+  190641742, 1645390429, 264907697, 620389253, 1502074852, 927711160, \
+  364849192, 2049576050, 638580085, 547070247
+
+static const long zrng_default[STREAM_SIZE] = { ZRNG_SEEDS };
+static struct sim_ctx sim_default = {.zrng = {ZRNG_SEEDS},
+  .rng_kind = RNG_LCGRAND,
+  .event_kind = EVLIST_HEAP,
+  .mrg_seed = {12345, 12345, 12345, 12345, 12345, 12345}
+};
+
+/* The streams are generated a block at a time.  Z[i+1] through Z[i+LCG_LANES]
+   are Z[i] times MULT, MULT^2, ..., MULT^LCG_LANES, and each of these lanes
+   then advances by MULT^LCG_LANES, so that the lanes are independent and the
+   compiler can run them in SIMD registers.  Full 64-bit products reduced mod
+   2^31 - 1 give exactly the same integers as the 16-bit split arithmetic of
+   UNIRAN.  Each stream keeps the next LCG_BUFFER integers in its prefetch
+   buffer in the context; zrng always holds the one handed out last. */
+
+static const unsigned int lcg_mult[LCG_LANES] = {	/* MULT^1 ... MULT^8. */
+  630360016, 1549035330, 264620982, 529512731,
+  1896697821, 2116530888, 1923129168, 1674201058
+};
+
+static inline unsigned int
+lcg_mulmod (unsigned int z, unsigned int mult)
+{
+  unsigned long long p = (unsigned long long) z * mult;
+  unsigned int r = (unsigned int) ((p & MODLUS) + (p >> 31));
+
+  return r >= MODLUS ? r - MODLUS : r;
+}
+
+static void
+lcg_fill (unsigned int z, unsigned int *out, int n)
+{
+
+/* Place the n integers that follow z in its stream into out. */
+
+  unsigned int lane[LCG_LANES];
+  int i, j;
+
+  for (i = 0; i < LCG_LANES; ++i)
+    lane[i] = lcg_mulmod (z, lcg_mult[i]);
+  for (j = 0; j + LCG_LANES <= n; j += LCG_LANES)
+    for (i = 0; i < LCG_LANES; ++i)
+      {
+	out[j + i] = lane[i];
+	lane[i] = lcg_mulmod (lane[i], lcg_mult[LCG_LANES - 1]);
+      }
+  for (i = 0; i < LCG_LANES && j < n; ++i, ++j)
+    out[j] = lane[i];
+}
+
+static inline unsigned int
+lcg_next (struct sim_ctx *ctx, int stream)
+{
+
+/* Hand out the next integer of stream "stream", refilling its prefetch
+   buffer when it runs dry. */
+
+  if (ctx->rng_pos[stream] == ctx->rng_len[stream])
+    {
+      lcg_fill ((unsigned int) ctx->zrng[stream], ctx->rng_buf[stream], LCG_BUFFER);
+      ctx->rng_pos[stream] = 0;
+      ctx->rng_len[stream] = LCG_BUFFER;
+    }
+  ctx->zrng[stream] = ctx->rng_buf[stream][ctx->rng_pos[stream]++];
+  return (unsigned int) ctx->zrng[stream];
+}
+
+/* Generate the next random number. */
+
+double
+sim_lcgrand (struct sim_ctx *ctx, int stream)
+{
+  double u = (lcg_next (ctx, stream) >> 7 | 1) / 16777216.0;
+
+  return ctx->antithetic ? 1.0 - u : u;
+}
+
+void
+sim_lcgrand_fill (struct sim_ctx *ctx, int stream, double u[], int n)
+{
+
+/* Place the next n random numbers from stream "stream" into u[0] through
+   u[n - 1], in the order lcgrand would return them.  Large requests bypass
+   the prefetch buffer and are generated directly in blocks. */
+
+  unsigned int z[LCG_BLOCK];
+  int i, k, m;
+
+  for (k = 0; k < n && ctx->rng_pos[stream] < ctx->rng_len[stream]; ++k)
+    u[k] = (lcg_next (ctx, stream) >> 7 | 1) / 16777216.0;
+  while (n - k >= LCG_BUFFER)
+    {
+      m = (n - k < LCG_BLOCK) ? n - k : LCG_BLOCK;
+      lcg_fill ((unsigned int) ctx->zrng[stream], z, m);
+      for (i = 0; i < m; ++i)
+	u[k + i] = (z[i] >> 7 | 1) / 16777216.0;
+      ctx->zrng[stream] = z[m - 1];
+      k += m;
+    }
+  for (; k < n; ++k)
+    u[k] = (lcg_next (ctx, stream) >> 7 | 1) / 16777216.0;
+  if (ctx->antithetic)
+    for (k = 0; k < n; ++k)
+      u[k] = 1.0 - u[k];
+}
+
+void
+sim_expon_fill (struct sim_ctx *ctx, double mean, int stream, double x[], int n)
+{
+
+/* Place n exponential variates with mean "mean" from stream "stream" into
+   x, the same ones n calls of expon would return. */
+
+  int i;
+
+  urand_fill (ctx, stream, x, n);
+  for (i = 0; i < n; ++i)
+    x[i] = -mean * log (x[i]);
+}
+
+void
+sim_uniform_fill (struct sim_ctx *ctx, double a, double b, int stream, double x[], int n)
+{
+
+/* Place n U(a,b) variates from stream "stream" into x, the same ones n calls
+   of uniform would return. */
+
+  int i;
+
+  urand_fill (ctx, stream, x, n);
+  for (i = 0; i < n; ++i)
+    x[i] = a + x[i] * (b - a);
+}
+
+void
+sim_lcgrandst (struct sim_ctx *ctx, long zset, int stream)	/* Set the current zrng for stream
+					   "stream" to zset. */
+{
+  ctx->zrng[stream] = zset;
+  ctx->rng_pos[stream] = ctx->rng_len[stream] = 0;
+}
+
+long
+sim_lcgrandgt (struct sim_ctx *ctx, int stream)		/* Return the current zrng for stream "stream". */
+{
+  return ctx->zrng[stream];
+}
+
+void
+sim_lcgrandvs (struct sim_ctx *ctx, long vstream, int stream)
+{
+
+/* Set the current zrng for stream "stream" to the start of virtual stream
+   vstream. */
+
+  unsigned long long z, mult;
+  long long nskip;
+
+  if (vstream < 1 || vstream > MAX_VSTREAM || stream < 1 || stream > MAX_STREAM)
     {
-      fprintf (unit, "\n\n%5d", ivar);
-      sampst (0.00, -ivar);
-      for (iatrr = 1; iatrr <= 4; ++iatrr)
-	pprint_out (unit, iatrr);
+      printf ("\nVirtual lcgrand stream %ld cannot be set on stream %d\n", vstream, stream);
+      exit (1);
     }
-  fprintf (unit, "\n___________________________________");
-  fprintf (unit, "_____________________________________\n\n\n");
+
+  /* Advance the default seed of stream 1 by (vstream - 1) spacings, which
+     amounts to multiplying it by MULT to that power, mod MODLUS. */
+
+  z = zrng_default[1];
+  mult = MULT;
+  for (nskip = (long long) (vstream - 1) * VSTREAM_SPACING; nskip > 0; nskip >>= 1)
+    {
+      if (nskip & 1)
+	z = z * mult % MODLUS;
+      mult = mult * mult % MODLUS;
+    }
+  ctx->zrng[stream] = (long) z;
+  ctx->rng_pos[stream] = ctx->rng_len[stream] = 0;
+}
+
+/* Combined multiple recursive generator MRG32k3a of L'Ecuyer, with streams
+   and substreams as in his RngStreams package.  The generator has period
+   about 2^191; stream s starts 2^127 (s - 1) values past the package seed
+   and is divided into substreams of 2^76 values each.  Streams are created
+   on demand, in any number and order, by jumping ahead from the seed with
+   the matrix A^(2^127) raised to the power s - 1, so two streams, or two
+   substreams of a stream, never overlap.  Replications that use substream r
+   of every stream are thus disjoint without any seed table.
+
+   Usage: (in addition to rng_select, see below)
+
+   1. To obtain the next U(0,1) random number from stream "stream,"
+      execute
+          u = mrgrand(stream);
+      where stream is any int from 1 up.
+
+   2. To move stream "stream" to the start of its substream number
+      substream (0 being the start of the stream), or on to its next
+      substream, execute
+          mrgrandss(substream, stream);
+          mrgrandns(stream);
+
+   3. To change the package seed, which discards all the streams created so
+      far, execute
+          mrgrandsd(seed);
+      where seed is an array of 6 unsigned long integers, the first three
+      below 4294967087 and the last three below 4294944443, neither triple
+      all zero.  The default seed is 12345 six times. */
+
+#define MRG_M1      4294967087LL
+#define MRG_M2      4294944443LL
+#define MRG_A12        1403580LL
+#define MRG_A13N        810728LL
+#define MRG_A21         527612LL
+#define MRG_A23N       1370589LL
+#define MRG_NORM    2.328306549295727688e-10	/* 1 / (MRG_M1 + 1). */
+
+struct mrg_stream
+{
+  unsigned long long cg[6];	/* Current state. */
+  unsigned long long bg[6];	/* Start of the current substream. */
+  unsigned long long ig[6];	/* Start of the stream. */
+  int created;
+};
+
+/* A^(2^76) and A^(2^127) for both components, i.e., the jumps to the next
+   substream and to the next stream. */
+
+static const unsigned long long mrg_a1p76[3][3] = {
+  {82758667ULL, 1871391091ULL, 4127413238ULL},
+  {3672831523ULL, 69195019ULL, 1871391091ULL},
+  {3672091415ULL, 3528743235ULL, 69195019ULL}
+};
+
+static const unsigned long long mrg_a2p76[3][3] = {
+  {1511326704ULL, 3759209742ULL, 1610795712ULL},
+  {4292754251ULL, 1511326704ULL, 3889917532ULL},
+  {3859662829ULL, 4292754251ULL, 3708466080ULL}
+};
+
+static const unsigned long long mrg_a1p127[3][3] = {
+  {2427906178ULL, 3580155704ULL, 949770784ULL},
+  {226153695ULL, 1230515664ULL, 3580155704ULL},
+  {1988835001ULL, 986791581ULL, 1230515664ULL}
+};
+
+static const unsigned long long mrg_a2p127[3][3] = {
+  {1464411153ULL, 277697599ULL, 1610723613ULL},
+  {32183930ULL, 1464411153ULL, 1022607788ULL},
+  {2824425944ULL, 32183930ULL, 2093834863ULL}
+};
+
+static void
+mrg_mat_vec (const unsigned long long a[3][3], const unsigned long long v[3], unsigned long long w[3], unsigned long long m)
+{
+
+/* Compute w = a v mod m.  Every entry is below 2^32, so each product fits
+   in 64 bits. */
+
+  unsigned long long x[3];
+  int i;
+
+  for (i = 0; i < 3; ++i)
+    x[i] = (a[i][0] * v[0] % m + a[i][1] * v[1] % m + a[i][2] * v[2] % m) % m;
+  for (i = 0; i < 3; ++i)
+    w[i] = x[i];
+}
+
+static void
+mrg_mat_mat (const unsigned long long a[3][3], const unsigned long long b[3][3], unsigned long long c[3][3], unsigned long long m)
+{
+
+/* Compute c = a b mod m; c may be a or b. */
+
+  unsigned long long x[3][3];
+  int i, j;
+
+  for (i = 0; i < 3; ++i)
+    for (j = 0; j < 3; ++j)
+      x[i][j] = (a[i][0] * b[0][j] % m + a[i][1] * b[1][j] % m + a[i][2] * b[2][j] % m) % m;
+  memcpy (c, x, sizeof (x));
+}
+
+static void
+mrg_jump (const unsigned long long a1[3][3], const unsigned long long a2[3][3], unsigned long long n, const unsigned long long from[6], unsigned long long to[6])
+{
+
+/* Advance state "from" by n jumps, a1 and a2 being the matrices of one jump
+   for the two components, and store the result in "to". */
+
+  unsigned long long p1[3][3], p2[3][3], x[6];
+
+  memcpy (p1, a1, sizeof (p1));
+  memcpy (p2, a2, sizeof (p2));
+  memcpy (x, from, sizeof (x));
+  for (; n > 0; n >>= 1)
+    {
+      if (n & 1)
+	{
+	  mrg_mat_vec ((const unsigned long long (*)[3]) p1, x, x, MRG_M1);
+	  mrg_mat_vec ((const unsigned long long (*)[3]) p2, x + 3, x + 3, MRG_M2);
+	}
+      mrg_mat_mat ((const unsigned long long (*)[3]) p1, (const unsigned long long (*)[3]) p1, p1, MRG_M1);
+      mrg_mat_mat ((const unsigned long long (*)[3]) p2, (const unsigned long long (*)[3]) p2, p2, MRG_M2);
+    }
+  memcpy (to, x, sizeof (x));
+}
+
+static struct mrg_stream *
+mrg_get (struct sim_ctx *ctx, int stream)
+{
+
+/* Return stream "stream", creating it if this is its first use. */
+
+  struct mrg_stream *g;
+  int old_max;
+
+  if (stream < 1)
+    {
+      printf ("\n%d is an improper value for an mrgrand stream at time %f\n", stream, ctx->sim_time);
+      exit (1);
+    }
+  if (stream >= ctx->mrg_max)
+    {
+      old_max = ctx->mrg_max;
+      ctx->mrg_max = (ctx->mrg_max > 0) ? ctx->mrg_max : 16;
+      while (stream >= ctx->mrg_max)
+	ctx->mrg_max *= 2;
+      ctx->mrg = (struct mrg_stream *) realloc (ctx->mrg, ctx->mrg_max * sizeof (struct mrg_stream));
+      memset (ctx->mrg + old_max, 0, (ctx->mrg_max - old_max) * sizeof (struct mrg_stream));
+    }
+  g = &ctx->mrg[stream];
+  if (!g->created)
+    {
+      mrg_jump (mrg_a1p127, mrg_a2p127, (unsigned long long) (stream - 1), ctx->mrg_seed, g->ig);
+      memcpy (g->bg, g->ig, sizeof (g->ig));
+      memcpy (g->cg, g->ig, sizeof (g->ig));
+      g->created = 1;
+    }
+  return g;
+}
+
+double
+sim_mrgrand (struct sim_ctx *ctx, int stream)
+{
+
+/* Generate the next random number from MRG32k3a stream "stream". */
+
+  struct mrg_stream *g;
+  long long p1, p2;
+  double u;
+
+  g = (stream < ctx->mrg_max && ctx->mrg[stream].created) ? &ctx->mrg[stream] : mrg_get (ctx, stream);
+
+  /* Component 1. */
+
+  p1 = (MRG_A12 * (long long) g->cg[1] - MRG_A13N * (long long) g->cg[0]) % MRG_M1;
+  if (p1 < 0)
+    p1 += MRG_M1;
+  g->cg[0] = g->cg[1];
+  g->cg[1] = g->cg[2];
+  g->cg[2] = p1;
+
+  /* Component 2. */
+
+  p2 = (MRG_A21 * (long long) g->cg[5] - MRG_A23N * (long long) g->cg[3]) % MRG_M2;
+  if (p2 < 0)
+    p2 += MRG_M2;
+  g->cg[3] = g->cg[4];
+  g->cg[4] = g->cg[5];
+  g->cg[5] = p2;
+
+  /* Combination. */
+
+  u = ((p1 > p2) ? (p1 - p2) : (p1 - p2 + MRG_M1)) * MRG_NORM;
+  return ctx->antithetic ? 1.0 - u : u;
+}
+
+void
+sim_mrgrandss (struct sim_ctx *ctx, long long substream, int stream)
+{
+
+/* Move stream "stream" to the start of its substream number substream. */
+
+  struct mrg_stream *g = mrg_get (ctx, stream);
+
+  if (substream < 0)
+    {
+      printf ("\n%lld is an improper value for an mrgrand substream\n", substream);
+      exit (1);
+    }
+  mrg_jump (mrg_a1p76, mrg_a2p76, (unsigned long long) substream, g->ig, g->bg);
+  memcpy (g->cg, g->bg, sizeof (g->bg));
+}
+
+void
+sim_mrgrandns (struct sim_ctx *ctx, int stream)
+{
+
+/* Move stream "stream" to the start of its next substream. */
+
+  struct mrg_stream *g = mrg_get (ctx, stream);
+
+  mrg_jump (mrg_a1p76, mrg_a2p76, 1, g->bg, g->bg);
+  memcpy (g->cg, g->bg, sizeof (g->bg));
+}
+
+void
+sim_mrgrandsd (struct sim_ctx *ctx, unsigned long seed[6])
+{
+
+/* Set the package seed and discard the streams created so far. */
+
+  int i;
+
+  for (i = 0; i < 6; ++i)
+    ctx->mrg_seed[i] = seed[i];
+  if (ctx->mrg_max > 0)
+    memset (ctx->mrg, 0, ctx->mrg_max * sizeof (struct mrg_stream));
+}
+
+void
+sim_rng_select (struct sim_ctx *ctx, int kind)
+{
+
+/* Select the generator behind expon, uniform, random_integer, erlang and
+   their _fill variants: RNG_LCGRAND (the default) or RNG_MRG32K3A.  The
+   stream numbers passed to those functions then refer to streams of that
+   generator.  lcgrand and mrgrand are not affected. */
+
+  if (kind != RNG_LCGRAND && kind != RNG_MRG32K3A)
+    {
+      printf ("\n%d is an improper value for a random-number generator\n", kind);
+      exit (1);
+    }
+  ctx->rng_kind = kind;
+}
+
+void
+sim_rng_antithetic (struct sim_ctx *ctx, int on)
+{
+
+/* Make lcgrand and mrgrand, and so every variate-generation function, return
+   1 - U in place of each U(0,1) random number U if "on" is nonzero, or U
+   again if it is zero.  A run with the same seeds and antithetic numbers on
+   is the antithetic twin of the run with them off. */
+
+  ctx->antithetic = (on != 0);
+}
+
+static inline double
+urand (struct sim_ctx *ctx, int stream)
+{
+
+/* Generate the next U(0,1) random number from stream "stream" of the
+   selected generator. */
+
+  return (ctx->rng_kind == RNG_MRG32K3A) ? sim_mrgrand (ctx, stream) : sim_lcgrand (ctx, stream);
+}
+
+static void
+urand_fill (struct sim_ctx *ctx, int stream, double u[], int n)
+{
+
+/* Place the next n U(0,1) random numbers from stream "stream" of the
+   selected generator into u. */
+
+  int i;
+
+  if (ctx->rng_kind == RNG_MRG32K3A)
+    for (i = 0; i < n; ++i)
+      u[i] = sim_mrgrand (ctx, stream);
+  else
+    sim_lcgrand_fill (ctx, stream, u, n);
+}
+
+double
+student_t95 (int df)
+{
+
+/* Return the 0.975 quantile of Student's t distribution with df degrees of
+   freedom, i.e., the multiplier of the standard error in a 95% confidence
+   interval.  Exact to three decimals up to 30 degrees of freedom; beyond
+   that a Cornish-Fisher expansion around the normal quantile is used. */
+
+  static const double t[31] = { 0.0,
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+  };
+  const double z = 1.959964;
+
+  if (df < 1)
+    return INFINITY;
+  if (df <= 30)
+    return t[df];
+  return z + (z * z * z + z) / (4.0 * df)
+    + (5.0 * pow (z, 5) + 16.0 * z * z * z + 3.0 * z) / (96.0 * df * df);
+}
+
+struct sim_ctx *
+sim_ctx_new (void)
+{
+
+/* Allocate a new simulation context with the default random-number seeds.
+   sim_init must be called on it before it is used. */
+
+  struct sim_ctx *ctx;
+
+  ctx = (struct sim_ctx *) calloc (1, sizeof (struct sim_ctx));
+  if (ctx == NULL)
+    {
+      printf ("\nOut of memory for a simulation context\n");
+      exit (1);
+    }
+  memcpy (ctx->zrng, zrng_default, sizeof (zrng_default));
+  ctx->rng_kind = RNG_LCGRAND;
+  ctx->event_kind = EVLIST_HEAP;
+  memcpy (ctx->mrg_seed, sim_default.mrg_seed, sizeof (ctx->mrg_seed));
+  return ctx;
+}
+
+void
+sim_ctx_delete (struct sim_ctx *ctx)
+{
+
+/* Release context ctx and all the memory it holds.  If ctx is the current
+   context of the calling thread, the thread falls back to the default
+   context. */
+
+  sim_release (ctx);
+  if (sim_current == ctx)
+    sim_current = &sim_default;
+  if (ctx != &sim_default)
+    free (ctx);
+}
+
+void
+sim_ctx_bind (struct sim_ctx *ctx)
+{
+
+/* Make ctx the context used by the classic simlib interface in the calling
+   thread.  A NULL ctx selects the default context. */
+
+  sim_current = (ctx != NULL) ? ctx : &sim_default;
+}
+
+/* A checkpoint is a binary image of a context taken between events: a
+   header (struct ckpt_header) followed by transfer, the list ranks and sizes,
+   the records of every list from head to tail, the event slots and heap with
+   the attributes of the pending events, the statistical accumulators, the
+   random-number streams and finally a block of user data, such as the state
+   of the model.  Slots keep their numbers and generations, so event handles
+   taken before the checkpoint stay valid after the restore.  The image is
+   only meant to be read back by the same build of simlib on the same kind of
+   machine, which the header checks.  The profile, if any, is not saved. */
+
+#define CKPT_MAGIC "simlibck"
+
+struct ckpt_header
+{
+  char magic[8];
+  size_t sizes[6];		/* Sizes of the structures written raw. */
+  size_t user_size;		/* Size of the user data. */
+  int width;			/* Doubles per attribute block. */
+  int maxatr, maxlist, next_event_type, rng_kind, antithetic;
+  int num_sampst, num_timest;
+  int event_max, event_free, type_max, mrg_max;
+  int warmup_watched, warmup_pending;
+  unsigned long event_seq;
+  double sim_time, treset, warmup_end;
+  double prob_distrib[26];
+  unsigned long long mrg_seed[6];
+};
+
+static void
+ckpt_sizes (size_t sizes[6])
+{
+
+/* Fill in the sizes that a checkpoint must agree on with this build. */
+
+  sizes[0] = sizeof (struct ckpt_header);
+  sizes[1] = sizeof (struct event_slot);
+  sizes[2] = sizeof (struct event_entry);
+  sizes[3] = sizeof (struct sampst_acc);
+  sizes[4] = sizeof (struct timest_acc);
+  sizes[5] = sizeof (struct sim_ctx) + sizeof (struct mrg_stream);
+}
+
+int
+sim_checkpoint (struct sim_ctx *ctx, const char *path, const void *user, size_t user_size)
+{
+
+/* Write a checkpoint of ctx, followed by user_size bytes of user data at
+   "user", to file "path".  This may be done at any time between two calls of
+   timing.  Return 1 if the checkpoint was written, 0 if not. */
+
+  struct ckpt_header header;
+  struct master *row;
+  struct fifo *f;
+  FILE *file;
+  size_t width = ctx->value_pool.size / sizeof (double);
+  int list, i, n, ok;
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, CKPT_MAGIC, sizeof (header.magic));
+  ckpt_sizes (header.sizes);
+  header.user_size = user_size;
+  header.width = (int) width;
+  header.maxatr = ctx->maxatr;
+  header.maxlist = ctx->maxlist;
+  header.num_sampst = ctx->num_sampst;
+  header.num_timest = ctx->num_timest;
+  header.next_event_type = ctx->next_event_type;
+  header.rng_kind = ctx->rng_kind;
+  header.antithetic = ctx->antithetic;
+  header.event_max = ctx->event_max;
+  header.event_free = ctx->event_free;
+  header.type_max = ctx->type_max;
+  header.mrg_max = ctx->mrg_max;
+  header.event_seq = ctx->event_seq;
+  header.sim_time = ctx->sim_time;
+  header.treset = ctx->treset;
+  header.warmup_watched = ctx->warmup_watched;
+  header.warmup_pending = ctx->warmup_pending;
+  header.warmup_end = ctx->warmup_end;
+  memcpy (header.prob_distrib, ctx->prob_distrib, sizeof (header.prob_distrib));
+  memcpy (header.mrg_seed, ctx->mrg_seed, sizeof (header.mrg_seed));
+
+  file = fopen (path, "wb");
+  if (file == NULL)
+    return 0;
+  fwrite (&header, sizeof (header), 1, file);
+  fwrite (ctx->transfer, sizeof (double), width, file);
+  fwrite (ctx->list_rank, sizeof (int), ctx->maxlist + 1, file);
+  fwrite (ctx->list_size, sizeof (int), ctx->maxlist + 1, file);
+
+  /* Write the lists, each one preceded by whether it is FIFO. */
+
+  for (list = 0; list <= ctx->maxlist; ++list)
+    {
+      if (list == LIST_EVENT)
+	continue;
+      f = &ctx->fifo[list];
+      i = (f->rec != NULL);
+      fwrite (&i, sizeof (int), 1, file);
+      if (f->rec != NULL)
+	for (i = 0, n = f->first; i < ctx->list_size[list]; ++i, n = (n + 1 == f->cap) ? 0 : n + 1)
+	  fwrite (f->rec + n * width, sizeof (double), width, file);
+      else
+	for (row = ctx->head[list]; row != NULL; row = row->sr)
+	  fwrite (row->value, sizeof (double), width, file);
+    }
+
+  /* Write the event list: the type chains, the slots (whose value pointers
+     are meaningless on disk), the keys of the events and their attributes,
+     in heap order (in slot order from the calendar). */
+
+  fwrite (ctx->type_first, sizeof (int), ctx->type_max, file);
+  fwrite (ctx->event_slot, sizeof (struct event_slot), ctx->event_max, file);
+  if (ctx->event_kind == EVLIST_CALENDAR)
+    {
+      for (i = 0; i < ctx->event_max; ++i)
+	if (ctx->event_slot[i].pos >= 0)
+	  fwrite (&ctx->event_heap[i], sizeof (struct event_entry), 1, file);
+      for (i = 0; i < ctx->event_max; ++i)
+	if (ctx->event_slot[i].pos >= 0)
+	  fwrite (ctx->event_slot[i].value, sizeof (double), width, file);
+    }
+  else
+    {
+      fwrite (ctx->event_heap, sizeof (struct event_entry), ctx->list_size[LIST_EVENT], file);
+      for (i = 0; i < ctx->list_size[LIST_EVENT]; ++i)
+	fwrite (ctx->event_slot[ctx->event_heap[i].slot].value, sizeof (double), width, file);
+    }
+
+  /* Write the statistics, the random-number streams and the user data. */
+
+  fwrite (ctx->sampst, sizeof (struct sampst_acc), ctx->num_sampst + 1, file);
+  fwrite (ctx->timest, sizeof (struct timest_acc), ctx->num_timest + 1, file);
+  fwrite (ctx->list_timest, sizeof (struct timest_acc), ctx->maxlist + 1, file);
+  fwrite (ctx->zrng, sizeof (ctx->zrng), 1, file);
+  fwrite (ctx->rng_buf, sizeof (ctx->rng_buf), 1, file);
+  fwrite (ctx->rng_pos, sizeof (ctx->rng_pos), 1, file);
+  fwrite (ctx->rng_len, sizeof (ctx->rng_len), 1, file);
+  if (ctx->mrg_max > 0)
+    fwrite (ctx->mrg, sizeof (struct mrg_stream), ctx->mrg_max, file);
+  if (user_size > 0)
+    fwrite (user, 1, user_size, file);
+
+  ok = !ferror (file);
+  if (fclose (file) != 0)
+    ok = 0;
+  return ok;
+}
+
+static int
+ckpt_take (char **cursor, char *end, void *to, size_t size)
+{
+
+/* Copy the next size bytes of a checkpoint image to "to", unless the image
+   ends first.  Return 1 if they were there. */
+
+  if ((size_t) (end - *cursor) < size)
+    return 0;
+  memcpy (to, *cursor, size);
+  *cursor += size;
+  return 1;
+}
+
+int
+sim_restore (struct sim_ctx *ctx, const char *path, void *user, size_t user_size)
+{
+
+/* Replace the state of ctx by the checkpoint in file "path", written by
+   sim_checkpoint, and copy its user data to "user", which must be user_size
+   bytes long as when the checkpoint was written.  The file is read in one go.
+   The simulation then resumes exactly where the checkpoint was taken.
+   Return 1 if it was restored, 0 if the file could not be read or is not a
+   checkpoint of this build; in the latter case ctx is left unchanged, but
+   if the file turns out to be truncated after its header, ctx must be
+   initialized again. */
+
+  struct ckpt_header header;
+  struct master *row;
+  struct fifo *f;
+  FILE *file;
+  char *image, *cursor, *end;
+  size_t sizes[6], width;
+  long length;
+  int list, i, n, is_fifo, ok = 0;
+
+  /* Read the whole file. */
+
+  file = fopen (path, "rb");
+  if (file == NULL)
+    return 0;
+  if (fseek (file, 0L, SEEK_END) != 0 || (length = ftell (file)) < 0 || fseek (file, 0L, SEEK_SET) != 0)
+    {
+      fclose (file);
+      return 0;
+    }
+  image = (char *) malloc (length > 0 ? length : 1);
+  if (image == NULL || fread (image, 1, length, file) != (size_t) length)
+    {
+      free (image);
+      fclose (file);
+      return 0;
+    }
+  fclose (file);
+  cursor = image;
+  end = image + length;
+
+  /* Check the header. */
+
+  ckpt_sizes (sizes);
+  if (!ckpt_take (&cursor, end, &header, sizeof (header))
+      || memcmp (header.magic, CKPT_MAGIC, sizeof (header.magic)) != 0
+      || memcmp (header.sizes, sizes, sizeof (sizes)) != 0 || header.user_size != user_size)
+    {
+      free (image);
+      return 0;
+    }
+
+  /* Start afresh with attribute blocks of the same width, then put back the
+     scalars. */
+
+  width = header.width;
+  ctx->maxatr = header.width - 1;
+  ctx->maxlist = header.maxlist;
+  sim_init (ctx);
+  ctx->maxatr = header.maxatr;
+  ctx->next_event_type = header.next_event_type;
+  ctx->rng_kind = header.rng_kind;
+  ctx->antithetic = header.antithetic;
+  ctx->event_seq = header.event_seq;
+  ctx->sim_time = header.sim_time;
+  ctx->treset = header.treset;
+  ctx->warmup_watched = header.warmup_watched;
+  ctx->warmup_pending = header.warmup_pending;
+  ctx->warmup_end = header.warmup_end;
+  memcpy (ctx->prob_distrib, header.prob_distrib, sizeof (header.prob_distrib));
+  memcpy (ctx->mrg_seed, header.mrg_seed, sizeof (header.mrg_seed));
+
+  if (!ckpt_take (&cursor, end, ctx->transfer, width * sizeof (double))
+      || !ckpt_take (&cursor, end, ctx->list_rank, (ctx->maxlist + 1) * sizeof (int))
+      || !ckpt_take (&cursor, end, ctx->list_size, (ctx->maxlist + 1) * sizeof (int)))
+    goto done;
+
+  /* Rebuild the lists. */
+
+  for (list = 0; list <= ctx->maxlist; ++list)
+    {
+      if (list == LIST_EVENT)
+	continue;
+      n = ctx->list_size[list];
+      if (!ckpt_take (&cursor, end, &is_fifo, sizeof (int)) || (size_t) (end - cursor) < n * width * sizeof (double))
+	goto done;
+      if (is_fifo)
+	{
+	  ctx->list_size[list] = 0;
+	  sim_list_fifo (ctx, list);
+	  ctx->list_size[list] = n;
+	  f = &ctx->fifo[list];
+	  if (n > f->cap)
+	    {
+	      while (n > f->cap)
+		f->cap *= 2;
+	      f->rec = (double *) realloc (f->rec, f->cap * width * sizeof (double));
+	      if (f->rec == NULL)
+		{
+		  printf ("\nOut of memory for simlib records\n");
+		  exit (1);
+		}
+	    }
+	  ckpt_take (&cursor, end, f->rec, n * width * sizeof (double));
+	}
+      else
+	for (i = 0; i < n; ++i)
+	  {
+	    row = (struct master *) pool_get (&ctx->row_pool);
+	    row->value = (double *) pool_get (&ctx->value_pool);
+	    ckpt_take (&cursor, end, row->value, width * sizeof (double));
+	    row->pr = ctx->tail[list];
+	    row->sr = NULL;
+	    if (row->pr != NULL)
+	      row->pr->sr = row;
+	    else
+	      ctx->head[list] = row;
+	    ctx->tail[list] = row;
+	  }
+    }
+
+  /* Rebuild the event list. */
+
+  n = ctx->list_size[LIST_EVENT];
+  if (header.event_max > ctx->event_max)
+    {
+      ctx->event_heap = (struct event_entry *) realloc (ctx->event_heap, header.event_max * sizeof (struct event_entry));
+      ctx->event_slot = (struct event_slot *) realloc (ctx->event_slot, header.event_max * sizeof (struct event_slot));
+    }
+  if (header.type_max > ctx->type_max)
+    ctx->type_first = (int *) realloc (ctx->type_first, header.type_max * sizeof (int));
+  ctx->event_max = header.event_max;
+  ctx->event_free = header.event_free;
+  ctx->type_max = header.type_max;
+  if (!ckpt_take (&cursor, end, ctx->type_first, ctx->type_max * sizeof (int))
+      || !ckpt_take (&cursor, end, ctx->event_slot, ctx->event_max * sizeof (struct event_slot))
+      || !ckpt_take (&cursor, end, ctx->event_heap, n * sizeof (struct event_entry))
+      || (size_t) (end - cursor) < n * width * sizeof (double))
+    goto done;
+  for (i = 0; i < ctx->event_max; ++i)
+    ctx->event_slot[i].value = NULL;
+  for (i = 0; i < n; ++i)
+    {
+      ctx->event_slot[ctx->event_heap[i].slot].value = (double *) pool_get (&ctx->value_pool);
+      ckpt_take (&cursor, end, ctx->event_slot[ctx->event_heap[i].slot].value, width * sizeof (double));
+    }
+  if (ctx->event_kind == EVLIST_CALENDAR)
+    cal_restore (ctx, n);
+  else
+    for (i = 0; i < n; ++i)
+      event_sift_up (ctx, i);
+
+  /* Put back the statistics, the random-number streams and the user data. */
+
+  if (header.num_sampst > ctx->num_sampst)
+    sampst_grow (ctx, header.num_sampst);
+  if (header.num_timest > ctx->num_timest)
+    timest_grow (ctx, header.num_timest);
+  if (!ckpt_take (&cursor, end, ctx->sampst, (header.num_sampst + 1) * sizeof (struct sampst_acc))
+      || !ckpt_take (&cursor, end, ctx->timest, (header.num_timest + 1) * sizeof (struct timest_acc))
+      || !ckpt_take (&cursor, end, ctx->list_timest, (ctx->maxlist + 1) * sizeof (struct timest_acc))
+      || !ckpt_take (&cursor, end, ctx->zrng, sizeof (ctx->zrng))
+      || !ckpt_take (&cursor, end, ctx->rng_buf, sizeof (ctx->rng_buf))
+      || !ckpt_take (&cursor, end, ctx->rng_pos, sizeof (ctx->rng_pos))
+      || !ckpt_take (&cursor, end, ctx->rng_len, sizeof (ctx->rng_len)))
+    goto done;
+  free (ctx->mrg);
+  ctx->mrg = NULL;
+  ctx->mrg_max = header.mrg_max;
+  if (ctx->mrg_max > 0)
+    {
+      ctx->mrg = (struct mrg_stream *) malloc (ctx->mrg_max * sizeof (struct mrg_stream));
+      if (ctx->mrg == NULL || !ckpt_take (&cursor, end, ctx->mrg, ctx->mrg_max * sizeof (struct mrg_stream)))
+	goto done;
+    }
+  if (user_size > 0 && !ckpt_take (&cursor, end, user, user_size))
+    goto done;
+  ok = (cursor == end);
+
+done:
+  free (image);
+  return ok;
+}
+
+/* The classic simlib interface.  Each of these functions works on the
+   current context of the calling thread. */
+
+void
+init_simlib (void)
+{
+  sim_init (sim_current);
+}
+
+void
+list_file (int option, int list)
+{
+  sim_list_file (sim_current, option, list);
+}
+
+void
+list_remove (int option, int list)
+{
+  sim_list_remove (sim_current, option, list);
 }
 
 void
-out_timest (FILE * unit, int lowvar, int highvar)
+list_append (int list)
 {
+  sim_list_append (sim_current, list);
+}
 
-/* Write timest statistics for variables lowvar through highvar on file
-   "unit". */
+void
+list_prepend (int list)
+{
+  sim_list_prepend (sim_current, list);
+}
 
-  int ivar, iatrr;
+void
+list_insert_increasing (int list)
+{
+  sim_list_insert_increasing (sim_current, list);
+}
 
-  if (lowvar > highvar || lowvar > TIM_VAR || highvar > TIM_VAR)
-    return;
+void
+list_insert_decreasing (int list)
+{
+  sim_list_insert_decreasing (sim_current, list);
+}
 
+void
+list_pop_front (int list)
+{
+  sim_list_pop_front (sim_current, list);
+}
 
-  fprintf (unit, "\n  timest");
-  fprintf (unit, "\n variable       Time");
-  fprintf (unit, "\n  number       average          Maximum          Minimum");
-  fprintf (unit, "\n________________________________________________________");
-  for (ivar = lowvar; ivar <= highvar; ++ivar)
-    {
-      fprintf (unit, "\n\n%5d", ivar);
-      timest (0.00, -ivar);
-      for (iatrr = 1; iatrr <= 3; ++iatrr)
-	pprint_out (unit, iatrr);
-    }
-  fprintf (unit, "\n________________________________________________________");
-  fprintf (unit, "\n\n\n");
+void
+list_pop_back (int list)
+{
+  sim_list_pop_back (sim_current, list);
 }
 
 void
-out_filest (FILE * unit, int lowlist, int highlist)
+list_file_at (int option, int list, double time)
 {
+  sim_list_file_at (sim_current, option, list, time);
+}
 
-/* Write timest list-length statistics for lists lowlist through highlist on
-   file "unit". */
+void
+list_remove_at (int option, int list, double time)
+{
+  sim_list_remove_at (sim_current, option, list, time);
+}
 
-  int list, iatrr;
+long long
+event_insert_ranked (void)
+{
+  return sim_event_insert_ranked (sim_current);
+}
 
-  if (lowlist > highlist || lowlist > MAX_LIST || highlist > MAX_LIST)
-    return;
+void
+list_fifo (int list)
+{
+  sim_list_fifo (sim_current, list);
+}
 
-  fprintf (unit, "\n  File         Time");
-  fprintf (unit, "\n number       average          Maximum          Minimum");
-  fprintf (unit, "\n_______________________________________________________");
-  for (list = lowlist; list <= highlist; ++list)
-    {
-      fprintf (unit, "\n\n%5d", list);
-      filest (list);
-      for (iatrr = 1; iatrr <= 3; ++iatrr)
-	pprint_out (unit, iatrr);
-    }
-  fprintf (unit, "\n_______________________________________________________");
-  fprintf (unit, "\n\n\n");
+void
+out_profile (FILE * unit)
+{
+  sim_out_profile (sim_current, unit);
+}
+
+int
+trace_open (const char *path, long long records, int lists)
+{
+  return sim_trace_open (sim_current, path, records, lists);
 }
 
 void
-pprint_out (FILE * unit, int i)	/* Write ith entry in transfer to file
-				   "unit". */
+trace_close (void)
 {
-  if (transfer[i] == -1e30 || transfer[i] == 1e30)
-    fprintf (unit, " %#15.6G ", 0.00);
-  else
-    fprintf (unit, " %#15.6G ", transfer[i]);
+  sim_trace_close (sim_current);
 }
 
-double
-expon (double mean, int stream)	/* Exponential variate generation
-				   function. */
+int
+checkpoint (const char *path, const void *user, size_t user_size)
+{
+  return sim_checkpoint (sim_current, path, user, user_size);
+}
+
+int
+restore (const char *path, void *user, size_t user_size)
 {
-  return -mean * log (lcgrand (stream));
+  return sim_restore (sim_current, path, user, user_size);
+}
+
+void
+timing (void)
+{
+  sim_timing (sim_current);
+}
 
+long long
+event_schedule (double time_of_event, int type_of_event)
+{
+  return sim_event_schedule (sim_current, time_of_event, type_of_event);
 }
 
 int
-random_integer (double prob_distrib[], int stream)	/* Discrete-variate
-							   generation function. */
+event_cancel (int event_type)
 {
-  int i;
-  double u;
+  return sim_event_cancel (sim_current, event_type);
+}
 
-  u = lcgrand (stream);
+int
+event_cancel_handle (long long handle)
+{
+  return sim_event_cancel_handle (sim_current, handle);
+}
 
-  for (i = 1; u >= prob_distrib[i]; ++i)
-    ;
-  return i;
+void
+event_backend (int kind)
+{
+  sim_event_backend (sim_current, kind);
 }
 
 double
-uniform (double a, double b, int stream)	/* Uniform variate generation
-						   function. */
+sampst (double value, int variable)
 {
-  return a + lcgrand (stream) * (b - a);
+  return sim_sampst (sim_current, value, variable);
 }
 
 double
-erlang (int m, double mean, int stream)	/* Erlang variate generation
-					   function. */
+timest (double value, int variable)
 {
-  int i;
-  double mean_exponential, sum;
+  return sim_timest (sim_current, value, variable);
+}
 
-  mean_exponential = mean / m;
-  sum = 0.0;
-  for (i = 1; i <= m; ++i)
-    sum += expon (mean_exponential, stream);
-  return sum;
+void
+sampst_at (double value, int variable, double time)
+{
+  sim_sampst_at (sim_current, value, variable, time);
 }
 
-/* Prime modulus multiplicative linear congruential generator
+void
+timest_at (double value, int variable, double time)
+{
+  sim_timest_at (sim_current, value, variable, time);
+}
 
-   Z[i] = (630360016 * Z[i-1]) (mod(pow(2,31) - 1)), based on Marse and
-   Roberts' portable FORTRAN random-number generator UNIRAN.  Multiple
-   (100) streams are supported, with seeds spaced 100,000 apart.
-   Throughout, input argument "stream" must be an int giving the
-   desired stream number.  The header file lcgrand.h must be included in
-   the calling program (#include "lcgrand.h") before using these
-   functions.
+double
+filest (int list)
+{
+  return sim_filest (sim_current, list);
+}
 
-   Usage: (Three functions)
+double
+sampst_ci (int variable)
+{
+  return sim_sampst_ci (sim_current, variable);
+}
 
-   1. To obtain the next U(0,1) random number from stream "stream,"
-      execute
-          u = lcgrand(stream);
-      where lcgrand is a double function.  The double variable u will
-      contain the next random number.
+void
+sampst_track (int variable, double p)
+{
+  sim_sampst_track (sim_current, variable, p);
+}
 
-   2. To set the seed for stream "stream" to a desired value zset,
-      execute
-          lcgrandst(zset, stream);
-      where lcgrandst is a void function and zset must be a long set to
-      the desired seed, a number between 1 and 2147483646 (inclusive).
-      Default seeds for all 100 streams are given in the code.
+double
+sampst_quantile (int variable, double p)
+{
+  return sim_sampst_quantile (sim_current, variable, p);
+}
 
-   3. To get the current (most recently used) integer in the sequence
-      being generated for stream "stream" into the long variable zget,
-      execute
-          zget = lcgrandgt(stream);
-      where lcgrandgt is a long function. */
+void
+reset_stats (void)
+{
+  sim_reset_stats (sim_current);
+}
 
-/* Define the constants. */
+void
+warmup_sampst (int variable)
+{
+  sim_warmup_sampst (sim_current, variable);
+}
 
-#define MODLUS 2147483647
-#define MULT1       24112
-#define MULT2       26143
+void
+warmup_timest (int variable)
+{
+  sim_warmup_timest (sim_current, variable);
+}
 
-/* Set the default seeds for all 100 streams. */
-
-static long zrng[] = { 1,
-  1973272912, 281629770, 20006270, 1280689831, 2096730329, 1933576050,
-  913566091, 246780520, 1363774876, 604901985, 1511192140, 1259851944,
-  824064364, 150493284, 242708531, 75253171, 1964472944, 1202299975,
-  233217322, 1911216000, 726370533, 403498145, 993232223, 1103205531,
-  762430696, 1922803170, 1385516923, 76271663, 413682397, 726466604,
-  336157058, 1432650381, 1120463904, 595778810, 877722890, 1046574445,
-  68911991, 2088367019, 748545416, 622401386, 2122378830, 640690903,
-  1774806513, 2132545692, 2079249579, 78130110, 852776735, 1187867272,
-  1351423507, 1645973084, 1997049139, 922510944, 2045512870, 898585771,
-  243649545, 1004818771, 773686062, 403188473, 372279877, 1901633463,
-  498067494, 2087759558, 493157915, 597104727, 1530940798, 1814496276,
-  536444882, 1663153658, 855503735, 67784357, 1432404475, 619691088,
-  119025595, 880802310, 176192644, 1116780070, 277854671, 1366580350,
-  1142483975, 2026948561, 1053920743, 786262391, 1792203830, 1494667770,
-  1923011392, 1433700034, 1244184613, 1147297105, 539712780, 1545929719,
-  190641742, 1645390429, 264907697, 620389253, 1502074852, 927711160,
-  364849192, 2049576050, 638580085, 547070247
-};
+void
+warmup_filest (int list)
+{
+  sim_warmup_filest (sim_current, list);
+}
 
-/* Generate the next random number. */
+double
+warmup_end (void)
+{
+  return sim_warmup_end (sim_current);
+}
+
+double
+timest_ci (int variable)
+{
+  return sim_timest_ci (sim_current, variable);
+}
+
+double
+filest_ci (int list)
+{
+  return sim_filest_ci (sim_current, list);
+}
+
+void
+out_sampst (FILE * unit, int lowvar, int highvar)
+{
+  sim_out_sampst (sim_current, unit, lowvar, highvar);
+}
+
+void
+out_timest (FILE * unit, int lowvar, int highvar)
+{
+  sim_out_timest (sim_current, unit, lowvar, highvar);
+}
+
+void
+out_filest (FILE * unit, int lowlist, int highlist)
+{
+  sim_out_filest (sim_current, unit, lowlist, highlist);
+}
+
+double
+expon (double mean, int stream)
+{
+  return sim_expon (sim_current, mean, stream);
+}
+
+int
+random_integer (double prob_distrib[], int stream)
+{
+  return sim_random_integer (sim_current, prob_distrib, stream);
+}
+
+int
+random_alias (const struct alias_table *table, int stream)
+{
+  return sim_random_alias (sim_current, table, stream);
+}
+
+double
+uniform (double a, double b, int stream)
+{
+  return sim_uniform (sim_current, a, b, stream);
+}
+
+double
+erlang (int m, double mean, int stream)
+{
+  return sim_erlang (sim_current, m, mean, stream);
+}
 
 double
 lcgrand (int stream)
 {
-  long zi, lowprd, hi31;
+  return sim_lcgrand (sim_current, stream);
+}
+
+void
+lcgrandst (long zset, int stream)
+{
+  sim_lcgrandst (sim_current, zset, stream);
+}
 
-  zi = zrng[stream];
-  lowprd = (zi & 65535) * MULT1;
-  hi31 = (zi >> 16) * MULT1 + (lowprd >> 16);
-  zi = ((lowprd & 65535) - MODLUS) + ((hi31 & 32767) << 16) + (hi31 >> 15);
-  if (zi < 0)
-    zi += MODLUS;
-  lowprd = (zi & 65535) * MULT2;
-  hi31 = (zi >> 16) * MULT2 + (lowprd >> 16);
-  zi = ((lowprd & 65535) - MODLUS) + ((hi31 & 32767) << 16) + (hi31 >> 15);
-  if (zi < 0)
-    zi += MODLUS;
-  zrng[stream] = zi;
-  return (zi >> 7 | 1) / 16777216.0;
+long
+lcgrandgt (int stream)
+{
+  return sim_lcgrandgt (sim_current, stream);
 }
 
 void
-lcgrandst (long zset, int stream)	/* Set the current zrng for stream
-					   "stream" to zset. */
+lcgrandvs (long vstream, int stream)
+{
+  sim_lcgrandvs (sim_current, vstream, stream);
+}
+
+void
+lcgrand_fill (int stream, double u[], int n)
+{
+  sim_lcgrand_fill (sim_current, stream, u, n);
+}
+
+void
+expon_fill (double mean, int stream, double x[], int n)
 {
-  zrng[stream] = zset;
+  sim_expon_fill (sim_current, mean, stream, x, n);
+}
+
+void
+uniform_fill (double a, double b, int stream, double x[], int n)
+{
+  sim_uniform_fill (sim_current, a, b, stream, x, n);
+}
+
+double
+mrgrand (int stream)
+{
+  return sim_mrgrand (sim_current, stream);
+}
+
+void
+mrgrandss (long long substream, int stream)
+{
+  sim_mrgrandss (sim_current, substream, stream);
+}
+
+void
+mrgrandns (int stream)
+{
+  sim_mrgrandns (sim_current, stream);
+}
+
+void
+mrgrandsd (unsigned long seed[6])
+{
+  sim_mrgrandsd (sim_current, seed);
+}
+
+void
+rng_select (int kind)
+{
+  sim_rng_select (sim_current, kind);
+}
+
+void
+rng_antithetic (int on)
+{
+  sim_rng_antithetic (sim_current, on);
 }
 
 long
-lcgrandgt (int stream)		/* Return the current zrng for stream "stream". */
+pool_avoided (void)
+{
+  return sim_pool_avoided (sim_current);
+}
+
+void
+free_simlib (void)
 {
-  return zrng[stream];
+  sim_release (sim_current);
 }
@@ -7,35 +7,316 @@
 #include <math.h>
 #include "simlibdefs.h"
 
-/* Declare simlib global variables. */
+/* Declare simlib types. */
 
-extern int *list_rank, *list_size, next_event_type, maxatr, maxlist;
-extern double *transfer, sim_time, prob_distrib[26];
-extern struct master
+struct master
 {
   double *value;
   struct master *pr;
   struct master *sr;
-} **head, **tail;
+};
 
-/* Declare simlib functions. */
+struct pool			/* Pool of fixed-size blocks (see simlib.c). */
+{
+  size_t size;			/* Size of a block in bytes. */
+  void *free;			/* Released blocks, linked through their first word. */
+  void *chunks;			/* Allocated chunks, linked through their first word. */
+  char *next;			/* Next uncarved block of the newest chunk. */
+  int left;			/* Number of uncarved blocks in the newest chunk. */
+  long requests;		/* Number of blocks handed out. */
+  long mallocs;			/* Number of chunks allocated. */
+};
+
+struct fifo			/* Ring buffer of a FIFO list (see simlib.c). */
+{
+  double *rec;			/* cap records of maxatr attributes, or NULL. */
+  int first;			/* Index of the first record in rec. */
+  int cap;			/* Number of records rec can hold. */
+};
+
+struct batch_means		/* Non-overlapping batch means (see simlib.c). */
+{
+  double mean[MAX_BATCH];	/* Means of the completed batches. */
+  double sum;			/* Sum (timest: area) of the current batch. */
+  double size;			/* Observations (timest: time) per batch. */
+  double start;			/* timest: start time of the current batch. */
+  long count;			/* sampst: observations in the current batch. */
+  int num;			/* Number of completed batches. */
+  int merges;			/* Number of times the batch size doubled. */
+  int warmup;			/* 1 while watched for the end of the warm-up. */
+};
+
+struct p2_quantile		/* P-square estimator of a quantile (see simlib.c). */
+{
+  double p;			/* The quantile, between 0 and 1. */
+  double q[5];			/* Marker heights. */
+  double np[5];			/* Desired marker positions. */
+  long n[5];			/* Actual marker positions. */
+  long count;			/* Number of observations. */
+};
+
+struct alias_table		/* Alias table of a discrete distribution (see simlib.c). */
+{
+  int n;			/* Number of outcomes, 1 through n. */
+  double cut[MAX_ALIAS + 1];	/* Share of column i below which alias[i] is taken. */
+  int alias[MAX_ALIAS + 1];	/* Outcome sharing column i. */
+};
+
+struct trace_header		/* Start of a trace file (see simlib.c). */
+{
+  char magic[8];		/* "SIMTRACE". */
+  int record_size;		/* Bytes per record. */
+  int lists;			/* Lists whose lengths a record holds, at most TRACE_LISTS. */
+  long long count;		/* Number of records that follow. */
+};
+
+struct trace_record		/* One dispatched event in a trace file. */
+{
+  double time;			/* Event time. */
+  float attr[2];		/* Attributes 3 and 4 of the event. */
+  short type;			/* Event type. */
+  unsigned short events;	/* Events left on the event list, up to TRACE_LENGTH_MAX. */
+  unsigned short length[TRACE_LISTS];	/* Lengths of lists 1 through lists of the header, likewise. */
+};
+
+struct sampst_acc		/* Accumulators of a sampst variable. */
+{
+  double sum, max, min;
+  int num_observations;
+  double mean, m2;		/* Running mean and sum of squared deviations. */
+  struct batch_means batch;
+  struct p2_quantile quant[MAX_QUANT];
+  int num_quant;		/* Number of quantiles tracked. */
+};
+
+struct timest_acc		/* Accumulators of a timest variable. */
+{
+  double area, max, min, preval, tlvc;
+  double mean, m2;		/* Time-weighted running mean and sum of squared deviations. */
+  struct batch_means batch;
+};
+
+/* A simulation context holds the complete state of one simulation: the
+   clock, the lists and the event list, the statistical accumulators and the
+   random-number streams.  Contexts share nothing, so independent simulations
+   may run in different threads, each one with its own context. */
+
+struct sim_ctx
+{
+  /* The classic simlib global variables. */
+
+  int *list_rank, *list_size, next_event_type, maxatr, maxlist;
+  double *transfer, sim_time, prob_distrib[26];
+  struct master **head, **tail;
+
+  /* Ring buffers of the lists declared FIFO (see simlib.c). */
+
+  struct fifo *fifo;
+  int fifo_lists;
+
+  /* Profile of the run, if simlib is compiled with SIMLIB_PROFILE. */
+
+  struct sim_profile *profile;
+
+  /* Trace file being recorded, if simlib is compiled with SIMLIB_TRACE. */
+
+  struct sim_trace *trace;
+
+  /* The event list (see simlib.c). */
+
+  struct event_entry *event_heap;
+  struct event_slot *event_slot;
+  int event_max, event_free, *type_first, type_max;
+  unsigned long event_seq;
+  int event_kind;
+  struct sim_calendar *calendar;
+
+  /* Storage for list records and attribute blocks. */
+
+  struct pool row_pool, value_pool;
+
+  /* Accumulators for sampst and timest, grown as variables are used:
+     sampst[1] through [num_sampst], timest[1] through [num_timest], and
+     list_timest[0] through [maxlist] for the lengths of the lists. */
+
+  struct sampst_acc *sampst;
+  struct timest_acc *timest, *list_timest;
+  int num_sampst, num_timest;
+  double treset;
+
+  /* Detection of the end of the warm-up (see simlib.c): the number of
+     variables watched and of those still in their transient, and the time
+     the statistics were reset, or -1. */
+
+  int warmup_watched, warmup_pending;
+  double warmup_end;
+
+  /* Random-number streams for lcgrand, each with a buffer of prefetched
+     integers rng_buf[stream][rng_pos] through [rng_len - 1]. */
+
+  long zrng[STREAM_SIZE];
+  unsigned int rng_buf[STREAM_SIZE][LCG_BUFFER];
+  int rng_pos[STREAM_SIZE], rng_len[STREAM_SIZE];
+
+  /* Random-number streams for mrgrand, created on demand, the generator
+     selected for the variate-generation functions, and whether both
+     generators return antithetic numbers 1 - U. */
+
+  struct mrg_stream *mrg;
+  int mrg_max;
+  unsigned long long mrg_seed[6];
+  int rng_kind;
+  int antithetic;
+};
+
+/* Declare the current context of the calling thread. */
+
+extern _Thread_local struct sim_ctx *sim_current;
+
+/* Declare simlib functions working on an explicit context. */
+
+extern struct sim_ctx *sim_ctx_new (void);
+extern void sim_ctx_delete (struct sim_ctx *ctx);
+extern void sim_ctx_bind (struct sim_ctx *ctx);
+extern void sim_init (struct sim_ctx *ctx);
+extern void sim_release (struct sim_ctx *ctx);
+extern void sim_list_file (struct sim_ctx *ctx, int option, int list);
+extern void sim_list_remove (struct sim_ctx *ctx, int option, int list);
+extern void sim_list_append (struct sim_ctx *ctx, int list);
+extern void sim_list_prepend (struct sim_ctx *ctx, int list);
+extern void sim_list_insert_increasing (struct sim_ctx *ctx, int list);
+extern void sim_list_insert_decreasing (struct sim_ctx *ctx, int list);
+extern void sim_list_pop_front (struct sim_ctx *ctx, int list);
+extern void sim_list_pop_back (struct sim_ctx *ctx, int list);
+extern void sim_list_file_at (struct sim_ctx *ctx, int option, int list, double time);
+extern void sim_list_remove_at (struct sim_ctx *ctx, int option, int list, double time);
+extern long long sim_event_insert_ranked (struct sim_ctx *ctx);
+extern void sim_list_fifo (struct sim_ctx *ctx, int list);
+extern void sim_timing (struct sim_ctx *ctx);
+extern long long sim_event_schedule (struct sim_ctx *ctx, double time_of_event, int type_of_event);
+extern int sim_event_cancel (struct sim_ctx *ctx, int event_type);
+extern int sim_event_cancel_handle (struct sim_ctx *ctx, long long handle);
+extern void sim_event_backend (struct sim_ctx *ctx, int kind);
+extern double sim_sampst (struct sim_ctx *ctx, double value, int varibl);
+extern double sim_timest (struct sim_ctx *ctx, double value, int varibl);
+extern void sim_sampst_at (struct sim_ctx *ctx, double value, int variable, double time);
+extern void sim_timest_at (struct sim_ctx *ctx, double value, int variable, double time);
+extern double sim_filest (struct sim_ctx *ctx, int list);
+extern double sim_sampst_ci (struct sim_ctx *ctx, int variable);
+extern void sim_sampst_track (struct sim_ctx *ctx, int variable, double p);
+extern double sim_sampst_quantile (struct sim_ctx *ctx, int variable, double p);
+extern double sim_timest_ci (struct sim_ctx *ctx, int variable);
+extern double sim_filest_ci (struct sim_ctx *ctx, int list);
+extern void sim_reset_stats (struct sim_ctx *ctx);
+extern void sim_warmup_sampst (struct sim_ctx *ctx, int variable);
+extern void sim_warmup_timest (struct sim_ctx *ctx, int variable);
+extern void sim_warmup_filest (struct sim_ctx *ctx, int list);
+extern double sim_warmup_end (struct sim_ctx *ctx);
+extern void sim_out_sampst (struct sim_ctx *ctx, FILE * unit, int lowvar, int highvar);
+extern void sim_out_timest (struct sim_ctx *ctx, FILE * unit, int lowvar, int highvar);
+extern void sim_out_filest (struct sim_ctx *ctx, FILE * unit, int lowlist, int highlist);
+extern double sim_expon (struct sim_ctx *ctx, double mean, int stream);
+extern int sim_random_integer (struct sim_ctx *ctx, double distrib[], int stream);
+extern int sim_random_alias (struct sim_ctx *ctx, const struct alias_table *table, int stream);
+extern double sim_uniform (struct sim_ctx *ctx, double a, double b, int stream);
+extern double sim_erlang (struct sim_ctx *ctx, int m, double mean, int stream);
+extern double sim_lcgrand (struct sim_ctx *ctx, int stream);
+extern void sim_lcgrandst (struct sim_ctx *ctx, long zset, int stream);
+extern long sim_lcgrandgt (struct sim_ctx *ctx, int stream);
+extern void sim_lcgrandvs (struct sim_ctx *ctx, long vstream, int stream);
+extern void sim_lcgrand_fill (struct sim_ctx *ctx, int stream, double u[], int n);
+extern void sim_expon_fill (struct sim_ctx *ctx, double mean, int stream, double x[], int n);
+extern void sim_uniform_fill (struct sim_ctx *ctx, double a, double b, int stream, double x[], int n);
+extern double sim_mrgrand (struct sim_ctx *ctx, int stream);
+extern void sim_mrgrandss (struct sim_ctx *ctx, long long substream, int stream);
+extern void sim_mrgrandns (struct sim_ctx *ctx, int stream);
+extern void sim_mrgrandsd (struct sim_ctx *ctx, unsigned long seed[6]);
+extern void sim_rng_select (struct sim_ctx *ctx, int kind);
+extern void sim_rng_antithetic (struct sim_ctx *ctx, int on);
+extern void sim_out_profile (struct sim_ctx *ctx, FILE * unit);
+extern int sim_trace_open (struct sim_ctx *ctx, const char *path, long long records, int lists);
+extern void sim_trace_close (struct sim_ctx *ctx);
+extern int sim_checkpoint (struct sim_ctx *ctx, const char *path, const void *user, size_t user_size);
+extern int sim_restore (struct sim_ctx *ctx, const char *path, void *user, size_t user_size);
+extern long sim_pool_avoided (struct sim_ctx *ctx);
+
+/* Declare simlib functions working on the current context. */
 
 extern void init_simlib (void);
 extern void list_file (int option, int list);
 extern void list_remove (int option, int list);
+extern void list_append (int list);
+extern void list_prepend (int list);
+extern void list_insert_increasing (int list);
+extern void list_insert_decreasing (int list);
+extern void list_pop_front (int list);
+extern void list_pop_back (int list);
+extern void list_file_at (int option, int list, double time);
+extern void list_remove_at (int option, int list, double time);
+extern long long event_insert_ranked (void);
+extern void list_fifo (int list);
 extern void timing (void);
-extern void event_schedule (double time_of_event, int type_of_event);
+extern long long event_schedule (double time_of_event, int type_of_event);
 extern int event_cancel (int event_type);
+extern int event_cancel_handle (long long handle);
+extern void event_backend (int kind);
 extern double sampst (double value, int varibl);
 extern double timest (double value, int varibl);
+extern void sampst_at (double value, int variable, double time);
+extern void timest_at (double value, int variable, double time);
 extern double filest (int list);
+extern double sampst_ci (int variable);
+extern void sampst_track (int variable, double p);
+extern double sampst_quantile (int variable, double p);
+extern double timest_ci (int variable);
+extern double filest_ci (int list);
+extern void reset_stats (void);
+extern void warmup_sampst (int variable);
+extern void warmup_timest (int variable);
+extern void warmup_filest (int list);
+extern double warmup_end (void);
 extern void out_sampst (FILE * unit, int lowvar, int highvar);
 extern void out_timest (FILE * unit, int lowvar, int highvar);
 extern void out_filest (FILE * unit, int lowlist, int highlist);
 extern double expon (double mean, int stream);
-extern int random_integer (double prob_distrib[], int stream);
+extern int random_integer (double distrib[], int stream);
+extern int random_alias (const struct alias_table *table, int stream);
 extern double uniform (double a, double b, int stream);
 extern double erlang (int m, double mean, int stream);
 extern double lcgrand (int stream);
 extern void lcgrandst (long zset, int stream);
 extern long lcgrandgt (int stream);
+extern void lcgrandvs (long vstream, int stream);
+extern void lcgrand_fill (int stream, double u[], int n);
+extern void expon_fill (double mean, int stream, double x[], int n);
+extern void uniform_fill (double a, double b, int stream, double x[], int n);
+extern double mrgrand (int stream);
+extern void mrgrandss (long long substream, int stream);
+extern void mrgrandns (int stream);
+extern void mrgrandsd (unsigned long seed[6]);
+extern void rng_select (int kind);
+extern void rng_antithetic (int on);
+extern void out_profile (FILE * unit);
+extern int trace_open (const char *path, long long records, int lists);
+extern void trace_close (void);
+extern int checkpoint (const char *path, const void *user, size_t user_size);
+extern int restore (const char *path, void *user, size_t user_size);
+extern long pool_avoided (void);
+extern void free_simlib (void);
+extern double student_t95 (int df);
+extern void alias_setup (struct alias_table *table, const double prob[], int n);
+
+/* Declare simlib global variables, which are those of the current context. */
+
+#ifndef SIMLIB_SOURCE
+#define list_rank       (sim_current->list_rank)
+#define list_size       (sim_current->list_size)
+#define next_event_type (sim_current->next_event_type)
+#define maxatr          (sim_current->maxatr)
+#define maxlist         (sim_current->maxlist)
+#define transfer        (sim_current->transfer)
+#define sim_time        (sim_current->sim_time)
+#define prob_distrib    (sim_current->prob_distrib)
+#define head            (sim_current->head)
+#define tail            (sim_current->tail)
+#endif
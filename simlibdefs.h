@@ -2,19 +2,26 @@
 
 /* Define limits. */
 
-#define MAX_LIST    25		/* Max number of lists. */
-#define MAX_ATTR    10		/* Max number of attributes. */
-#define MAX_SVAR    25		/* Max number of sampst variables. */
-#define TIM_VAR     25		/* Max number of timest variables. */
-#define MAX_TVAR    50		/* Max number of timest variables + lists. */
-#define EPSILON      0.001	/* Used in event_cancel. */
+#define MAX_LIST    25		/* Lists allocated by init_simlib; more are added when used. */
+#define MAX_ATTR    10		/* Default number of attributes (maxatr). */
+#define MAX_SVAR    25		/* sampst variables allocated by init_simlib; likewise. */
+#define MAX_TVAR    25		/* timest variables allocated by init_simlib; likewise. */
+#define TIM_VAR 1000000		/* timest variable TIM_VAR + list is the length of list "list". */
+#define MAX_STREAM 100		/* Max number of lcgrand streams. */
+#define MAX_VSTREAM 21474	/* Max number of virtual lcgrand streams. */
+#define EPSILON      0.001	/* Formerly used in event_cancel. */
 
 /* Define array sizes. */
 
-#define LIST_SIZE   26		/* MAX_LIST + 1. */
-#define ATTR_SIZE   11		/* MAX_ATTR + 1. */
-#define SVAR_SIZE   26		/* MAX_SVAR + 1. */
-#define TVAR_SIZE   51		/* MAX_TVAR + 1. */
+#define STREAM_SIZE 101		/* MAX_STREAM + 1. */
+#define LCG_LANES     8		/* Lanes used to generate a stream. */
+#define LCG_BUFFER   32		/* Prefetched numbers per stream. */
+#define MAX_BATCH    64		/* Max number of batch means per variable. */
+#define MAX_QUANT     4		/* Max number of quantiles per sampst variable. */
+#define MAX_ALIAS   128		/* Max number of outcomes of an alias table. */
+#define TRACE_LISTS   8		/* Max number of lists whose lengths a trace record holds. */
+#define TRACE_CHUNK 4194304	/* Records a trace file grows by at a time. */
+#define TRACE_LENGTH_MAX 65535	/* Largest list length a trace record holds. */
 
 /* Define options for list_file and list_remove. */
 
@@ -23,9 +30,20 @@
 #define INCREASING   3		/* Insert in increasing order. */
 #define DECREASING   4		/* Insert in decreasing order. */
 
+/* Define random-number generators for rng_select. */
+
+#define RNG_LCGRAND  1		/* lcgrand, 100 streams (the default). */
+#define RNG_MRG32K3A 2		/* mrgrand, any number of streams. */
+
+/* Define event-list backends for event_backend. */
+
+#define EVLIST_HEAP     1	/* Binary heap (the default). */
+#define EVLIST_CALENDAR 2	/* Calendar queue. */
+
 /* Define some other values. */
 
-#define LIST_EVENT  25		/* Event list number. */
+#define LIST_EVENT   0		/* Event list number. */
+#define MSER_MERGES  2		/* Batch doublings before looking for the warm-up end. */
 #ifdef INFINITY
 #undef INFINITY
 #endif
@@ -0,0 +1,125 @@
+/* Reader for the event traces recorded by simlib. */
+// A trace file (see trace_open in simlib.c) holds one fixed-size record per event dispatched by timing: its time, type, attributes 3 and 4
+// and the lengths of the event list and of the lists the trace was opened for (the header gives their number, at most TRACE_LISTS). This
+// tool prints the records as aligned text or as CSV, optionally only those in a window of simulated time and of some event types.
+
+#include <stddef.h>
+#include <string.h>
+#include "simlib.h" /* Required for struct trace_header and struct trace_record. */
+
+#define MAX_TYPES 64 /* Max number of event types to select. */
+
+int num_types;        // Number of event types selected, or 0 for all.
+int types[MAX_TYPES]; // Those event types.
+int num_lists;        // Number of lists whose lengths the records hold.
+
+int record_size(int lists) /* Return the bytes of a record holding the lengths of "lists" lists, as simlib cuts it. */
+{
+    size_t size = offsetof(struct trace_record, length) + (size_t)lists * sizeof(unsigned short);
+    return (int)((size + sizeof(double) - 1) / sizeof(double) * sizeof(double));
+}
+
+int selected(const struct trace_record *rec, double from, double until) /* Return whether record "rec" is in the time window and of a type selected. */
+{
+    int i;
+    if (rec->time < from || rec->time > until)
+        return 0;
+    for (i = 0; i < num_types; i++)
+        if (rec->type == types[i])
+            return 1;
+    return num_types == 0;
+}
+
+void print_record(const struct trace_record *rec, int csv) /* Print record "rec" as a row of text or of CSV. */
+{
+    int list;
+    if (csv) {
+        printf("%.10g,%d,%.10g,%.10g,%d", rec->time, rec->type, rec->attr[0], rec->attr[1], rec->events);
+        for (list = 0; list < num_lists; list++)
+            printf(",%d", rec->length[list]);
+    } else {
+        printf("%15.3f%6d%10g%10g%8d", rec->time, rec->type, rec->attr[0], rec->attr[1], rec->events);
+        for (list = 0; list < num_lists; list++)
+            printf("%7d", rec->length[list]);
+    }
+    printf("\n");
+}
+
+void print_header(int csv) /* Print the column names. */
+{
+    int list;
+    if (csv) {
+        printf("time,type,attr_3,attr_4,events");
+        for (list = 1; list <= num_lists; list++)
+            printf(",list_%d", list);
+    } else {
+        printf("%15s%6s%10s%10s%8s", "Time", "Type", "Attr 3", "Attr 4", "Events");
+        for (list = 1; list <= num_lists; list++)
+            printf("%6s%d", "L", list);
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[]) /* Main function. */
+{
+    struct trace_header header;
+    struct trace_record rec;
+    double from = -INFINITY, until = INFINITY;
+    long long n, shown = 0;
+    int csv = 0, i;
+    const char *path = NULL;
+    FILE *file;
+
+    /* Read the options: -c prints CSV instead of text, -f T and -u T keep the events from time T and until time T, -e T1,T2,... keeps the
+       events of types T1, T2, ... only. */
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0)
+            csv = 1;
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            from = atof(argv[++i]);
+        else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc)
+            until = atof(argv[++i]);
+        else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            char *p = argv[++i], *end;
+            for (num_types = 0; *p != '\0' && num_types < MAX_TYPES; p = (*end == ',') ? end + 1 : end) {
+                types[num_types++] = (int)strtol(p, &end, 10);
+                if (end == p) {
+                    fprintf(stderr, "%s: need event types separated by commas\n", argv[0]);
+                    return 1;
+                }
+            }
+        }
+        else if (argv[i][0] != '-' && path == NULL)
+            path = argv[i];
+        else {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL) {
+        fprintf(stderr, "usage: %s [-c] [-f from_time] [-u until_time] [-e type,type...] trace_file\n", argv[0]);
+        return 1;
+    }
+
+    file = fopen(path, "rb");
+    if (file == NULL || fread(&header, sizeof header, 1, file) != 1 || memcmp(header.magic, "SIMTRACE", 8) != 0 ||
+        header.lists < 0 || header.lists > TRACE_LISTS || header.record_size != record_size(header.lists)) {
+        fprintf(stderr, "%s: %s is not a trace of this build of simlib\n", argv[0], path);
+        return 1;
+    }
+    num_lists = header.lists;
+    print_header(csv);
+    memset(&rec, 0, sizeof rec);
+    for (n = 0; n < header.count && fread(&rec, (size_t)header.record_size, 1, file) == 1; n++)
+        if (selected(&rec, from, until)) {
+            print_record(&rec, csv);
+            shown++;
+        }
+    fclose(file);
+    if (n < header.count)
+        fprintf(stderr, "%s: %s ends after %lld of its %lld records\n", argv[0], path, n, header.count);
+    if (!csv)
+        fprintf(stderr, "%lld of %lld events shown\n", shown, n);
+    return 0;
+}